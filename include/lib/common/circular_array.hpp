@@ -24,104 +24,271 @@
 #include <cstring> // memcpy
 #include <memory>
 #include <iostream>
+#include <limits>
+#include <new> // placement new
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace common {
 
 /**
- * A simple queue implemented as a circular array. The data structure resizes the underlying storage when it becomes full, but like a Vector,
- * it never decreases its capacity once increased.
- * The class is not thread safe.
+ * A simple queue implemented as a circular array. The data structure doubles the capacity of the underlying storage when it becomes full,
+ * and halves it when, after a removal, the queue is only a quarter full. The gap between the two thresholds avoids to resize back and forth
+ * when the size oscillates around a power of 2. The capacity is never automatically shrunk below the minimum capacity, by default the initial
+ * capacity; #shrink_to_fit releases all the spare capacity on demand.
  *
- * The operations that can be performed are: Q.append(element), Q.prepend(element), Q.pop(), Q.size(), Q.empty() and Q[i] (accessor).
+ * By default, the capacity is exactly the one requested. The start of the queue is kept in [0, capacity) and its end as start + size,
+ * so that a position in the array is obtained with a comparison and a subtraction, rather than a division.
+ *
+ * With PowerOfTwo = true, the capacity is always rounded up to a power of 2. The start and the end of the queue are then kept as two
+ * counters that only move forwards (or backwards for prepend), wrapping around 2^64, and never reduced modulo the capacity: the size is
+ * their difference and a position in the array is obtained with a single AND, with no branches. This is the cheapest layout for the
+ * accessors, at the cost of up to twice the memory.
+ *
+ * The underlying storage is not initialised: the elements are constructed in place when inserted and destroyed when removed, thus
+ * T does not need to be default constructible and can be any movable type (e.g. std::string, std::unique_ptr). Trivially copyable
+ * types are relocated with memcpy on resize.
+ *
+ * The operations that can be performed are: Q.append(element), Q.prepend(element), Q.emplace_back(args...), Q.emplace_front(args...),
+ * Q.pop(), Q.size(), Q.empty() and Q[i] (accessor, checked) or Q.at_unchecked(i). Batches can be moved in and out with Q.append_bulk(items, n)
+ * and Q.pop_bulk(items, n), or the content can be accessed in place, e.g. for vectored I/O, as at most two contiguous spans with Q.spans().
+ *
+ * The storage is obtained from the given Allocator, e.g. to draw the memory of many queues from a shared arena or pool.
  *
  * The data structure is not thread safe.
  */
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>, bool PowerOfTwo = false>
 class CircularArray {
+    using AllocatorTraits = std::allocator_traits<Allocator>;
+
+    Allocator m_allocator; // the allocator for the underlying array
     T* m_array; //  the actual container of the elements
-    uint64_t m_start; // start index (incl)
-    uint64_t m_end; // last index (excl)
-    uint64_t m_capacity; // current capacity of the array m_array
-    bool m_empty; // whether the data structure is empty
+    uint64_t m_start; // counter of the first element (incl), in [0, m_capacity) unless PowerOfTwo
+    uint64_t m_end; // counter of the last element (excl), m_start + size()
+    uint64_t m_capacity; // current capacity of the array m_array, a power of 2 if PowerOfTwo
+    uint64_t m_mask; // m_capacity -1, only used if PowerOfTwo
+    uint64_t m_min_capacity; // the capacity is not automatically shrunk below this threshold
+
+public:
+    /**
+     * A contiguous range of elements in the underlying array
+     */
+    template<typename E>
+    struct BasicSpan {
+        E* m_data; // the first element of the range
+        uint64_t m_size; // the number of elements in the range
+
+        E* begin() const { return m_data; }
+        E* end() const { return m_data + m_size; }
+        uint64_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+    };
+    using Span = BasicSpan<T>;
+    using ConstSpan = BasicSpan<const T>;
+
+private:
+    // round up to the next power of 2, if PowerOfTwo
+    static uint64_t round_capacity(uint64_t capacity){
+        if(capacity > (1ull << 62)) throw std::invalid_argument("Invalid capacity: too big");
+        if constexpr (!PowerOfTwo) return capacity;
+        uint64_t result = 1;
+        while(result < capacity) result <<= 1;
+        return result;
+    }
+
+    // convert a counter in [m_start, m_end] to its position in the array
+    uint64_t slot(uint64_t counter) const noexcept {
+        if constexpr (PowerOfTwo){
+            return counter & m_mask;
+        } else { // counter < 2 * m_capacity
+            return counter >= m_capacity ? counter - m_capacity : counter;
+        }
+    }
+
+    // move the start of the queue forwards by `count' positions, after the elements have been removed
+    void advance_start(uint64_t count) noexcept {
+        m_start += count;
+        if constexpr (!PowerOfTwo){
+            if(m_start >= m_capacity){ m_start -= m_capacity; m_end -= m_capacity; }
+        }
+    }
+
+    // move the start of the queue backwards by one position, to insert a new element
+    void retreat_start() noexcept {
+        if constexpr (!PowerOfTwo){
+            if(m_start == 0){ m_start += m_capacity; m_end += m_capacity; }
+        }
+        m_start--;
+    }
+
+    // allocate the storage for `capacity' elements, without initialising them
+    T* allocate(uint64_t capacity){
+        return AllocatorTraits::allocate(m_allocator, capacity);
+    }
+
+    // release the storage obtained with #allocate. The elements must have been already destroyed
+    void deallocate(T* array, uint64_t capacity){
+        if(array != nullptr){ AllocatorTraits::deallocate(m_allocator, array, capacity); }
+    }
+
+    // move the elements [array + start, array + start + count) into the uninitialised storage `destination'
+    static void relocate(T* destination, T* array, uint64_t start, uint64_t count){
+        if constexpr (std::is_trivially_copyable_v<T>){
+            memcpy(destination, array + start, sizeof(T) * count);
+        } else {
+            for(uint64_t i = 0; i < count; i++){
+                new (destination + i) T(std::move(array[start + i]));
+                array[start + i].~T();
+            }
+        }
+    }
+
+    // copy the elements [items, items + count) into the uninitialised storage `destination'
+    static void copy_construct(T* destination, const T* items, uint64_t count){
+        if constexpr (std::is_trivially_copyable_v<T>){
+            memcpy(destination, items, sizeof(T) * count);
+        } else {
+            std::uninitialized_copy(items, items + count, destination);
+        }
+    }
+
+    // move the elements [array + start, array + start + count) into the (initialised) objects `destination' and destroy the source
+    static void move_out(T* destination, T* array, uint64_t start, uint64_t count){
+        if constexpr (std::is_trivially_copyable_v<T>){
+            memcpy(destination, array + start, sizeof(T) * count);
+        } else {
+            for(uint64_t i = 0; i < count; i++){
+                destination[i] = std::move(array[start + i]);
+                array[start + i].~T();
+            }
+        }
+    }
+
+    // destroy all elements in the array, without altering m_start and m_end
+    void destroy_all(){
+        if constexpr (!std::is_trivially_destructible_v<T>){
+            for(uint64_t i = m_start; i != m_end; i++){
+                m_array[slot(i)].~T();
+            }
+        }
+    }
 
 protected:
     // is the array full?
     bool full() const {
-        return !empty() && m_start == m_end;
+        return size() == m_capacity;
     }
 
-    // resize the capacity of the underlying array, and copy the elements
+    // resize the capacity of the underlying array, and move the elements
     void resize(uint64_t capacity){
         assert(capacity >= size() && "Cannot resize this array, it already contains more elements than the new capacity");
-        std::unique_ptr<T[]> new_array{ new T[capacity] };
-
-        // copy the elements from the old array to the new one
-        if(!empty()){
-            if(m_end > m_start){
-                memcpy(new_array.get(), m_array + m_start, sizeof(T) * (m_end - m_start));
-            } else { // m_end <= m_start
-                memcpy(new_array.get(), m_array + m_start, sizeof(T) * (m_capacity - m_start));
-                memcpy(new_array.get() + (m_capacity - m_start), m_array, sizeof(T) * m_end);
-            }
+        assert((!PowerOfTwo || (capacity & (capacity -1)) == 0) && "The capacity must be a power of 2");
+        T* new_array = allocate(capacity);
+        const uint64_t sz = size();
+
+        // move the elements from the old array to the new one
+        if(sz > 0){
+            const uint64_t start = slot(m_start);
+            const uint64_t first_sz = std::min<uint64_t>(sz, m_capacity - start);
+            relocate(new_array, m_array, start, first_sz);
+            relocate(new_array + first_sz, m_array, 0, sz - first_sz);
         }
 
         // swap new_array with m_array
-        delete[] m_array; m_array = new_array.get();
-        new_array.release(); // do not delete the array just allocated
+        deallocate(m_array, m_capacity); m_array = new_array;
 
-        m_end = size(); // do not swap the order with m_start
         m_start = 0;
+        m_end = sz;
         m_capacity = capacity;
+        m_mask = capacity -1;
+    }
+
+    // ensure there is room for `count' more elements, doubling the capacity as needed
+    void reserve_more(uint64_t count){
+        const uint64_t min_capacity = size() + count;
+        if(min_capacity > m_capacity){
+            resize(round_capacity(std::max<uint64_t>(min_capacity, m_capacity << 1 /* x2 */)));
+        }
+    }
+
+    // halve the capacity, possibly multiple times, while the array is at most a quarter full
+    void shrink_if_sparse(){
+        if(m_capacity <= m_min_capacity || size() > (m_capacity >> 2)) return; // fast path
+        uint64_t capacity = m_capacity;
+        while(capacity > m_min_capacity && size() <= (capacity >> 2)){ capacity >>= 1; }
+        resize(capacity);
     }
 
     // convert the given absolute index to its actual position in the array
     uint64_t to_array_index(int64_t index) const {
         if( index >= (int64_t) size() || index < 0 ) throw std::runtime_error("Index out of bounds");
-        if( m_end > m_start ){
-            return m_start + index;
-        } else { // m_end <= m_start
-            if(index < static_cast<int64_t>( m_capacity - m_start )) {
-                return m_start + index;
-            } else {
-                return index - (m_capacity - m_start);
-            }
-        }
+        return slot(m_start + index);
     }
 
 public:
     /**
-     * Initialise the container with the given initial capacity
+     * Initialise the container with the given initial capacity, rounded up to the next power of 2 if PowerOfTwo. The initial capacity
+     * is also the minimum capacity, the threshold below which the array is not automatically shrunk.
+     */
+    CircularArray(uint64_t capacity = 64, const Allocator& allocator = Allocator()) : m_allocator(allocator), m_array(nullptr), m_start(0), m_end(0),
+            m_capacity(round_capacity(capacity)), m_mask(m_capacity -1), m_min_capacity(m_capacity) {
+        m_array = allocate(m_capacity);
+    }
+
+    /**
+     * Move constructor. The other container is left empty, with no storage.
+     */
+    CircularArray(CircularArray&& other) noexcept : m_allocator(std::move(other.m_allocator)), m_array(other.m_array), m_start(other.m_start), m_end(other.m_end),
+            m_capacity(other.m_capacity), m_mask(other.m_mask), m_min_capacity(other.m_min_capacity) {
+        other.m_array = nullptr;
+        other.m_start = other.m_end = other.m_capacity = other.m_mask = 0;
+    }
+
+    /**
+     * Move assignment. Unless the allocator propagates on move assignment, the two allocators must compare equal.
      */
-    CircularArray(uint64_t capacity = 64) : m_array(nullptr), m_start(0), m_end(0), m_capacity(capacity), m_empty(true) {
-        m_array = new T[capacity];
+    CircularArray& operator=(CircularArray&& other) noexcept {
+        if(this != &other){
+            destroy_all();
+            deallocate(m_array, m_capacity);
+            if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value){
+                m_allocator = std::move(other.m_allocator);
+            } else {
+                assert(m_allocator == other.m_allocator && "The storage of the other container cannot be released by this allocator");
+            }
+            m_array = other.m_array; m_start = other.m_start; m_end = other.m_end; m_capacity = other.m_capacity; m_mask = other.m_mask;
+            m_min_capacity = other.m_min_capacity;
+            other.m_array = nullptr;
+            other.m_start = other.m_end = other.m_capacity = other.m_mask = 0;
+        }
+        return *this;
     }
 
+    // Not copyable
+    CircularArray(const CircularArray&) = delete;
+    CircularArray& operator=(const CircularArray&) = delete;
+
     /**
      * Destructor
      */
     ~CircularArray(){
-        delete[] m_array; m_array = nullptr;
+        destroy_all();
+        deallocate(m_array, m_capacity); m_array = nullptr;
     }
 
     /**
      * Is the container empty ?
      */
     bool empty() const {
-        assert((!m_empty || m_start == m_end) && "Precondition not respected");
-        return m_empty;
+        return m_start == m_end;
     }
 
     /**
      * Retrieve the number of elements contained
      */
     size_t size() const {
-        if(empty())
-            return 0;
-        else if (m_end > m_start)
-            return m_end - m_start;
-        else
-            return m_end + (m_capacity - m_start);
+        return m_end - m_start;
     }
 
     /**
@@ -131,38 +298,154 @@ public:
         return m_capacity;
     }
 
+    /**
+     * Retrieve the threshold below which the capacity is not automatically shrunk
+     */
+    size_t min_capacity() const {
+        return m_min_capacity;
+    }
+
+    /**
+     * Set the threshold below which the capacity is not automatically shrunk, rounded up to the next power of 2 if PowerOfTwo. Set it to
+     * std::numeric_limits<uint64_t>::max() to never shrink the array automatically.
+     */
+    void set_min_capacity(uint64_t capacity){
+        m_min_capacity = (capacity > (1ull << 62)) ? std::numeric_limits<uint64_t>::max() : round_capacity(capacity);
+    }
+
+    /**
+     * Reduce the capacity to the current number of elements (rounded up to the next power of 2 if PowerOfTwo), regardless of the
+     * minimum capacity
+     */
+    void shrink_to_fit(){
+        uint64_t capacity = round_capacity(std::max<uint64_t>(size(), 1));
+        if(capacity < m_capacity){ resize(capacity); }
+    }
+
+    /**
+     * Retrieve the allocator associated to the container
+     */
+    Allocator get_allocator() const {
+        return m_allocator;
+    }
+
+    /**
+     * Construct a new element at the end, with the given arguments
+     */
+    template<typename... Args>
+    T& emplace_back(Args&&... args){
+        if(full()){ resize(std::max<uint64_t>(m_capacity << 1 /* x2 */, 1)); }
+        T* element = new (m_array + slot(m_end)) T(std::forward<Args>(args)...);
+        m_end++;
+        return *element;
+    }
+
+    /**
+     * Construct a new element at the start, with the given arguments
+     */
+    template<typename... Args>
+    T& emplace_front(Args&&... args){
+        if(full()){ resize(std::max<uint64_t>(m_capacity << 1 /* x2 */, 1)); }
+        const uint64_t position = (slot(m_start) == 0) ? m_capacity -1 : slot(m_start) -1;
+        T* element = new (m_array + position) T(std::forward<Args>(args)...);
+        retreat_start();
+        return *element;
+    }
+
     /**
      * Append a new element at the end
      */
     void append(const T& item){
-        if(full()){ resize(m_capacity << 1 /* x2 */); }
-        m_array[m_end] = item;
-        m_end++;
-        if(m_end == m_capacity) m_end = 0;
-        m_empty = false;
+        emplace_back(item);
+    }
+
+    void append(T&& item){
+        emplace_back(std::move(item));
     }
 
     /**
      * Prepend a new element at the start
      */
     void prepend(const T& item){
-        if(full()){ resize(m_capacity << 1 /* x2 */); }
-        if(m_start == 0)
-            m_start = m_capacity -1;
-        else
-            m_start--;
-        m_array[m_start] = item;
-        m_empty = false;
+        emplace_front(item);
+    }
+
+    void prepend(T&& item){
+        emplace_front(std::move(item));
     }
 
     /**
-     * Remove the element at the start
+     * Remove the element at the start and return it
      */
-    void pop(){
+    T pop(){
         if(empty()) throw std::runtime_error("The queue is empty");
-        m_start++;
-        if(m_start >= m_capacity) m_start = 0;
-        m_empty = (m_start == m_end);
+        T& element = m_array[slot(m_start)];
+        T result { std::move(element) };
+        element.~T();
+        advance_start(1);
+        shrink_if_sparse();
+        return result;
+    }
+
+    /**
+     * Append the elements [items, items + num_items) at the end. The elements are copied with at most two memcpy
+     * for trivially copyable types.
+     */
+    void append_bulk(const T* items, uint64_t num_items){
+        if(num_items == 0) return;
+        reserve_more(num_items);
+        const uint64_t end = slot(m_end);
+        const uint64_t first_sz = std::min<uint64_t>(num_items, m_capacity - end);
+        copy_construct(m_array + end, items, first_sz);
+        copy_construct(m_array, items + first_sz, num_items - first_sz);
+        m_end += num_items;
+    }
+
+    /**
+     * Remove up to `num_items' elements from the start and move them into `items'. Return the number of elements removed.
+     * The elements are moved with at most two memcpy for trivially copyable types.
+     */
+    uint64_t pop_bulk(T* items, uint64_t num_items){
+        const uint64_t count = std::min<uint64_t>(num_items, size());
+        if(count == 0) return 0;
+        const uint64_t start = slot(m_start);
+        const uint64_t first_sz = std::min<uint64_t>(count, m_capacity - start);
+        move_out(items, m_array, start, first_sz);
+        move_out(items + first_sz, m_array, 0, count - first_sz);
+        advance_start(count);
+        shrink_if_sparse();
+        return count;
+    }
+
+    /**
+     * Remove the first `count' elements, e.g. once consumed through #spans
+     */
+    void discard(uint64_t count){
+        if(count > size()) throw std::runtime_error("Not enough elements in the queue");
+        if constexpr (!std::is_trivially_destructible_v<T>){
+            for(uint64_t i = 0; i < count; i++){ at_unchecked(i).~T(); }
+        }
+        advance_start(count);
+        shrink_if_sparse();
+    }
+
+    /**
+     * Retrieve the content of the queue as at most two contiguous ranges of the underlying array, in order. The
+     * second range is empty when the content does not wrap around the end of the array. The ranges are invalidated
+     * by any update to the queue.
+     */
+    std::pair<Span, Span> spans() noexcept {
+        const uint64_t sz = size();
+        const uint64_t start = slot(m_start);
+        const uint64_t first_sz = std::min<uint64_t>(sz, m_capacity - start);
+        return { Span{ m_array + start, first_sz }, Span{ m_array, sz - first_sz } };
+    }
+
+    std::pair<ConstSpan, ConstSpan> spans() const noexcept {
+        const uint64_t sz = size();
+        const uint64_t start = slot(m_start);
+        const uint64_t first_sz = std::min<uint64_t>(sz, m_capacity - start);
+        return { ConstSpan{ m_array + start, first_sz }, ConstSpan{ m_array, sz - first_sz } };
     }
 
     /**
@@ -179,64 +462,77 @@ public:
         return m_array[to_array_index(i)];
     }
 
+    /**
+     * Retrieve an element at given position, without checking the bounds. The position must be in [0, size()).
+     */
+    T& at_unchecked(uint64_t i) noexcept {
+        assert(i < size() && "Index out of bounds");
+        return m_array[slot(m_start + i)];
+    }
+
+    /**
+     * Retrieve an element at given position, without checking the bounds. The position must be in [0, size()).
+     */
+    const T& at_unchecked(uint64_t i) const noexcept {
+        assert(i < size() && "Index out of bounds");
+        return m_array[slot(m_start + i)];
+    }
+
+    /**
+     * Retrieve the first element, without checking whether the queue is empty
+     */
+    T& front() noexcept { return at_unchecked(0); }
+    const T& front() const noexcept { return at_unchecked(0); }
+
+    /**
+     * Retrieve the last element, without checking whether the queue is empty
+     */
+    T& back() noexcept { return at_unchecked(size() -1); }
+    const T& back() const noexcept { return at_unchecked(size() -1); }
+
     /**
      * Remove all elements in the queue.
-     * @param capacity if != 0, it sets the capacity of the underlying array
+     * @param capacity if != 0, it sets the capacity of the underlying array, rounded up to the next power of 2 if PowerOfTwo
      */
     void clear(uint64_t capacity = 0) {
+        destroy_all();
         m_start = m_end = 0;
-        m_empty = true;
+        if(capacity > 0){ capacity = round_capacity(capacity); }
         if(capacity > 0 && capacity != m_capacity){
-            T* new_array = new T[capacity];
-            delete[] m_array;
+            T* new_array = allocate(capacity);
+            deallocate(m_array, m_capacity);
             m_array = new_array;
             m_capacity = capacity;
+            m_mask = capacity -1;
         }
     }
 
     /**
-     * Remove the element in the data structure such that predicate[x] == true.
+     * Remove the element in the data structure such that predicate[x] == true. The remaining elements are compacted in
+     * place, the underlying array is never reallocated.
      * @param bool f(const T&): true if this
      * @param RemoveAll: whether to apply the predicate to all elements, or only to remove the first element that
-     *          does not satisfy the predicate
+     *          satisfies the predicate
      */
     template<typename F, bool RemoveAll = false>
     void remove(F predicate){
-        if(empty()) return;
-        int64_t start = m_start;
-        int64_t end = m_end;
-        int64_t i = start;
-        if(start < end){
-            for( ; i < end && !predicate(m_array[i]); i++) /* nop */ ;
-            int64_t j = i +1;
-            for( ; j < end; j++){ // this guard is not satisfied if there are no elements to remove
-                if(!RemoveAll || !predicate(m_array[j])){
-                    m_array[i++] = m_array[j];
-                }
-            }
+        const uint64_t sz = size();
+        uint64_t i = 0; // logical index of the next slot to fill
+        while(i < sz && !predicate(at_unchecked(i))) i++;
+        if(i == sz) return; // nothing to remove
 
-        } else { // start > end
-            const int64_t capacity = m_capacity;
-            int64_t j = start;
-            for( ; j < capacity; j++){
-                if((RemoveAll || i==j) && predicate(m_array[j])) continue;
-                m_array[i++] = m_array[j];
-            }
-            if(i >= capacity) i =0;
-            j = 0;
-            for( ; j < end; j++){
-                if((RemoveAll || i==j) && predicate(m_array[j])) continue;
-                m_array[i++] = m_array[j];
-                if(i >= capacity) i =0;
-            }
+        for(uint64_t j = i +1; j < sz; j++){
+            T& element = at_unchecked(j);
+            if(RemoveAll && predicate(element)) continue;
+            at_unchecked(i++) = std::move(element);
         }
 
-
-        assert(i >= 0);
-        if(i != m_end){ // Something has been removed
-            m_end = i;
-            m_empty = (m_end == m_start);
+        // destroy the elements left over at the end
+        if constexpr (!std::is_trivially_destructible_v<T>){
+            for(uint64_t j = i; j < sz; j++){ at_unchecked(j).~T(); }
         }
+
+        m_end = m_start + i;
     }
 
     /**
@@ -244,7 +540,7 @@ public:
      */
     void dump() const  {
         using namespace std;
-        cout << "[CircularArray size: " << size() << ", start: " << m_start << ", end: " << m_end << ", capacity: " << m_capacity << "\n";
+        cout << "[CircularArray size: " << size() << ", start: " << slot(m_start) << ", end: " << slot(m_end) << ", capacity: " << m_capacity << ", min capacity: " << m_min_capacity << "\n";
         for(size_t i =0, sz = size(); i < sz; i++){
             cout << "[" << i << "] " << m_array[to_array_index(i)] << "\n";
         }
@@ -0,0 +1,269 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONCURRENT_CIRCULAR_ARRAY_HPP_
+#define CONCURRENT_CIRCULAR_ARRAY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cinttypes>
+#include <memory>
+#include <stdexcept>
+
+namespace common {
+
+/**
+ * The concurrency supported by a ConcurrentCircularArray
+ */
+enum class QueueMode {
+    SPSC, // single producer, single consumer
+    MPSC, // multiple producers, single consumer
+};
+
+/**
+ * A bounded queue implemented as a circular array, safe to use concurrently by one consumer and either one (SPSC) or
+ * many (MPSC) producers. None of the operations block or take a lock: #append fails when the queue is full and #pop
+ * fails when the queue is empty.
+ *
+ * The capacity is fixed on initialisation, rounded up to a power of 2. The head (consumer) and the tail (producers)
+ * are kept in separate cache lines. In the SPSC mode, each side caches the last position observed of the other side,
+ * to avoid reading the shared counters on every operation. In the MPSC mode, each slot carries a sequence number,
+ * telling the producers whether the slot is free and the consumer whether the slot has been filled.
+ *
+ * The elements must be default constructible and copy assignable.
+ */
+template <typename T, QueueMode Mode = QueueMode::SPSC>
+class ConcurrentCircularArray {
+    constexpr static uint64_t m_cache_line = 64;
+
+    // A slot of the array, the sequence number is only used in the MPSC mode
+    struct Slot {
+        std::atomic<uint64_t> m_sequence; // MPSC: pos => free for the producer at pos, pos +1 => filled for the consumer at pos
+        T m_value;
+    };
+
+    const uint64_t m_capacity; // the number of slots, a power of 2
+    const uint64_t m_mask; // m_capacity -1
+    std::unique_ptr<Slot[]> m_slots; // the actual container of the elements
+
+    alignas(m_cache_line) std::atomic<uint64_t> m_head; // the next position to pop, only altered by the consumer
+    uint64_t m_tail_cached; // SPSC, consumer: the last value of m_tail observed
+
+    alignas(m_cache_line) std::atomic<uint64_t> m_tail; // the next position to fill, altered by the producers
+    uint64_t m_head_cached; // SPSC, producer: the last value of m_head observed
+
+    char m_padding[m_cache_line - sizeof(std::atomic<uint64_t>) - sizeof(uint64_t)]; // do not share the line of m_tail with the next objects
+
+    // Round up to the next power of 2
+    static uint64_t round_capacity(uint64_t capacity);
+
+    // Reserve up to `count' consecutive positions for a producer. Return the number of positions reserved, starting from `position'
+    uint64_t reserve(uint64_t count, uint64_t& position);
+
+public:
+    /**
+     * Initialise the queue with the given capacity, rounded up to the next power of 2
+     */
+    ConcurrentCircularArray(uint64_t capacity = 1024);
+
+    // Not copyable
+    ConcurrentCircularArray(const ConcurrentCircularArray&) = delete;
+    ConcurrentCircularArray& operator=(const ConcurrentCircularArray&) = delete;
+
+    /**
+     * Append a new element at the end. Return false if the queue is full.
+     */
+    bool append(const T& item);
+
+    /**
+     * Append up to `num_items' elements at the end, as a single batch. Return the number of elements appended, that
+     * is less than `num_items' only when the queue becomes full.
+     */
+    uint64_t append_bulk(const T* items, uint64_t num_items);
+
+    /**
+     * Remove the element at the start and store it into `item'. Return false if the queue is empty.
+     * Only the consumer can invoke this method.
+     */
+    bool pop(T& item);
+
+    /**
+     * Remove up to `num_items' elements from the start and store them into `items'. Return the number of elements
+     * removed. Only the consumer can invoke this method.
+     */
+    uint64_t pop_bulk(T* items, uint64_t num_items);
+
+    /**
+     * Is the container empty ? The result may be already outdated once returned, if other threads are operating on the queue.
+     */
+    bool empty() const;
+
+    /**
+     * Retrieve the number of elements contained. The result may be already outdated once returned, if other threads are
+     * operating on the queue.
+     */
+    size_t size() const;
+
+    /**
+     * Retrieve the capacity of the queue
+     */
+    size_t capacity() const;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template <typename T, QueueMode Mode>
+uint64_t ConcurrentCircularArray<T, Mode>::round_capacity(uint64_t capacity){
+    if(capacity == 0) throw std::invalid_argument("Invalid capacity: 0");
+    if(capacity > (1ull << 62)) throw std::invalid_argument("Invalid capacity: too big");
+    uint64_t result = 1;
+    while(result < capacity) result <<= 1;
+    return result;
+}
+
+template <typename T, QueueMode Mode>
+ConcurrentCircularArray<T, Mode>::ConcurrentCircularArray(uint64_t capacity) : m_capacity(round_capacity(capacity)), m_mask(m_capacity -1),
+        m_slots(new Slot[m_capacity]), m_head(0), m_tail_cached(0), m_tail(0), m_head_cached(0) {
+    for(uint64_t i = 0; i < m_capacity; i++){
+        m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T, QueueMode Mode>
+uint64_t ConcurrentCircularArray<T, Mode>::reserve(uint64_t count, uint64_t& position){
+    if constexpr (Mode == QueueMode::SPSC){
+        position = m_tail.load(std::memory_order_relaxed); // only this thread alters the tail
+        if(position + count - m_head_cached > m_capacity){ // refresh the position of the consumer
+            m_head_cached = m_head.load(std::memory_order_acquire);
+            count = std::min<uint64_t>(count, m_capacity - (position - m_head_cached));
+        }
+        return count;
+    } else {
+        position = m_tail.load(std::memory_order_relaxed);
+        while(true){
+            int64_t diff = static_cast<int64_t>(m_slots[position & m_mask].m_sequence.load(std::memory_order_acquire)) - static_cast<int64_t>(position);
+            if(diff < 0){ // the slot has not been consumed yet
+                return 0; // full
+            } else if(diff > 0){ // another producer moved the tail in the meanwhile
+                position = m_tail.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            // the consumer frees the slots in order: if the last slot of the batch is free, all the previous are free too
+            uint64_t num_free = count;
+            const uint64_t last = position + count -1;
+            if(count > 1 && m_slots[last & m_mask].m_sequence.load(std::memory_order_acquire) != last){
+                num_free = 1;
+                while(num_free < count && m_slots[(position + num_free) & m_mask].m_sequence.load(std::memory_order_acquire) == position + num_free){
+                    num_free++;
+                }
+            }
+
+            if(m_tail.compare_exchange_weak(position, position + num_free, std::memory_order_relaxed)){
+                return num_free;
+            } // else, position has been updated with the current value of the tail
+        }
+    }
+}
+
+template <typename T, QueueMode Mode>
+bool ConcurrentCircularArray<T, Mode>::append(const T& item){
+    return append_bulk(&item, 1) == 1;
+}
+
+template <typename T, QueueMode Mode>
+uint64_t ConcurrentCircularArray<T, Mode>::append_bulk(const T* items, uint64_t num_items){
+    if(num_items == 0) return 0;
+    uint64_t position = 0;
+    uint64_t count = reserve(std::min<uint64_t>(num_items, m_capacity), position);
+
+    for(uint64_t i = 0; i < count; i++){
+        Slot& slot = m_slots[(position + i) & m_mask];
+        slot.m_value = items[i];
+        if constexpr (Mode == QueueMode::MPSC){
+            slot.m_sequence.store(position + i + 1, std::memory_order_release); // publish the element
+        }
+    }
+
+    if constexpr (Mode == QueueMode::SPSC){
+        m_tail.store(position + count, std::memory_order_release); // publish the batch
+    }
+
+    return count;
+}
+
+template <typename T, QueueMode Mode>
+bool ConcurrentCircularArray<T, Mode>::pop(T& item){
+    return pop_bulk(&item, 1) == 1;
+}
+
+template <typename T, QueueMode Mode>
+uint64_t ConcurrentCircularArray<T, Mode>::pop_bulk(T* items, uint64_t num_items){
+    const uint64_t position = m_head.load(std::memory_order_relaxed); // only this thread alters the head
+    uint64_t count = 0;
+
+    if constexpr (Mode == QueueMode::SPSC){
+        if(position + num_items > m_tail_cached){ // refresh the position of the producer
+            m_tail_cached = m_tail.load(std::memory_order_acquire);
+        }
+        count = std::min<uint64_t>(num_items, m_tail_cached - position);
+        for(uint64_t i = 0; i < count; i++){
+            items[i] = std::move(m_slots[(position + i) & m_mask].m_value);
+        }
+    } else { // MPSC
+        while(count < num_items){
+            Slot& slot = m_slots[(position + count) & m_mask];
+            if(slot.m_sequence.load(std::memory_order_acquire) != position + count + 1) break; // not filled yet
+            items[count] = std::move(slot.m_value);
+            slot.m_sequence.store(position + count + m_capacity, std::memory_order_release); // free for the next round
+            count++;
+        }
+    }
+
+    if(count > 0){
+        m_head.store(position + count, std::memory_order_release);
+    }
+
+    return count;
+}
+
+template <typename T, QueueMode Mode>
+bool ConcurrentCircularArray<T, Mode>::empty() const {
+    return size() == 0;
+}
+
+template <typename T, QueueMode Mode>
+size_t ConcurrentCircularArray<T, Mode>::size() const {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t tail = m_tail.load(std::memory_order_acquire);
+    // MPSC: the tail may count slots reserved but not yet filled
+    return (tail > head) ? std::min<uint64_t>(tail - head, m_capacity) : 0;
+}
+
+template <typename T, QueueMode Mode>
+size_t ConcurrentCircularArray<T, Mode>::capacity() const {
+    return m_capacity;
+}
+
+} // namespace common
+
+#endif /* CONCURRENT_CIRCULAR_ARRAY_HPP_ */
@@ -0,0 +1,311 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_CONCURRENT_STATIC_INDEX_HPP
+#define COMMON_CONCURRENT_STATIC_INDEX_HPP
+
+#include <atomic>
+#include <cinttypes>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "static_index.hpp"
+
+namespace common {
+
+/**
+ * A StaticIndex that can be queried by many reader threads while a writer replaces its content.
+ *
+ * Readers never take a lock: they announce themselves in one of the reader slots, tagged with the
+ * current epoch, and then load the pointer to the current index. A writer never modifies an index that
+ * is visible to the readers. It builds a new index on the side, publishes it with an atomic exchange and
+ * retires the old one. A retired index is released once every busy reader slot carries an epoch
+ * greater than the epoch when the index was retired, that is, once no reader can still see it.
+ *
+ * The writers are serialised among themselves by a mutex. The readers only block when all the reader
+ * slots are taken at the same time, that is with more than #num_reader_slots() concurrent lookups.
+ */
+template<typename KeyType, typename Layout = index_layout::BTree<>>
+class ConcurrentStaticIndex {
+public:
+    using Index = StaticIndex<KeyType, Layout>;
+
+private:
+    // A reader slot, in its own cache line to avoid false sharing among the readers
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> m_epoch { 0 }; // 0 => the slot is free
+    };
+
+    // An index no longer visible to the new readers, waiting to be released
+    struct RetiredIndex {
+        Index* m_index; // the index to release
+        uint64_t m_epoch; // the epoch when the index was retired
+    };
+
+    constexpr static uint64_t m_num_slots = 128; // total number of reader slots
+    const uint64_t m_node_size; // the node size of the indexes created by #build
+    alignas(64) std::atomic<Index*> m_current; // the index visible to the readers
+    alignas(64) std::atomic<uint64_t> m_epoch; // the global epoch, incremented each time an index is retired
+    mutable ReaderSlot m_slots[m_num_slots]; // the epochs announced by the readers
+    std::mutex m_mutex_writers; // serialise the writers
+    std::vector<RetiredIndex> m_retired; // indexes waiting to be released, protected by m_mutex_writers
+
+    // Claim a reader slot, tagging it with the current epoch
+    uint64_t reader_enter() const noexcept;
+
+    // Release a reader slot previously claimed with #reader_enter
+    void reader_exit(uint64_t slot_id) const noexcept;
+
+    // Release the retired indexes that cannot be accessed anymore by any reader. It assumes the writer lock is held.
+    void reclaim_unsafe();
+
+public:
+    /**
+     * Initialise the index with the given node size and capacity
+     */
+    ConcurrentStaticIndex(uint64_t node_size = details::static_index::default_node_size<Layout>::value, uint64_t num_entries = 1);
+
+    /**
+     * Destructor. There must not be any reader or writer still operating on the index.
+     */
+    ~ConcurrentStaticIndex();
+
+    // Not copyable, the readers hold a reference to the slots of this instance
+    ConcurrentStaticIndex(const ConcurrentStaticIndex&) = delete;
+    ConcurrentStaticIndex& operator=(const ConcurrentStaticIndex&) = delete;
+
+    /**
+     * Replace the current content of the index with the given one. The previous index is released once
+     * the readers that may still access it have terminated.
+     */
+    void publish(std::unique_ptr<Index> index);
+
+    /**
+     * Create a new index from the given sorted separators, as in StaticIndex::build, and publish it.
+     * The construction happens on the side, the readers keep accessing the previous index in the meanwhile.
+     */
+    void build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads = 1);
+
+    /**
+     * Try to release the retired indexes that are not accessed by any reader. It is also implicitly invoked
+     * on each #publish. Returns the number of indexes still waiting to be released.
+     */
+    uint64_t reclaim();
+
+    /**
+     * Execute the given function on a consistent snapshot of the index, without blocking the writers.
+     * The snapshot, of type `const Index&', must not be retained after the function returns.
+     */
+    template<typename Fn>
+    auto read(Fn&& fn) const;
+
+    /**
+     * Same semantics of the lookups in StaticIndex, each invocation observes a single snapshot of the index
+     */
+    uint64_t find_lt(KeyType key) const noexcept;
+    uint64_t find_lte(KeyType key) const noexcept;
+    uint64_t find_lte_first(KeyType key) const noexcept;
+    uint64_t find_lte_last(KeyType key) const noexcept;
+    void find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+
+    /**
+     * Retrieve the minimum key in the current snapshot of the index
+     */
+    KeyType minimum() const noexcept;
+
+    /**
+     * Retrieve the node size of the indexes created by #build
+     */
+    uint64_t node_size() const noexcept;
+
+    /**
+     * Retrieve the maximum number of concurrent readers that do not block
+     */
+    static constexpr uint64_t num_reader_slots() noexcept;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template<typename KeyType, typename Layout>
+ConcurrentStaticIndex<KeyType, Layout>::ConcurrentStaticIndex(uint64_t node_size, uint64_t num_entries) :
+        m_node_size(node_size), m_current(nullptr), m_epoch(1) {
+    m_current.store(new Index(node_size, num_entries), std::memory_order_release);
+}
+
+template<typename KeyType, typename Layout>
+ConcurrentStaticIndex<KeyType, Layout>::~ConcurrentStaticIndex(){
+    for(auto& retired : m_retired){ delete retired.m_index; }
+    m_retired.clear();
+    delete m_current.load(std::memory_order_acquire);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::reader_enter() const noexcept {
+    // start from a slot depending on the thread, so that different threads tend to use different slots
+    thread_local uint64_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    uint64_t slot_id = hint % m_num_slots;
+    while(true){
+        uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+        uint64_t expected = 0;
+        // seq_cst: the announcement must be visible to the writer before we load the current index
+        if(m_slots[slot_id].m_epoch.load(std::memory_order_relaxed) == 0 && m_slots[slot_id].m_epoch.compare_exchange_strong(expected, epoch, std::memory_order_seq_cst)){
+            hint = slot_id;
+            return slot_id;
+        }
+        slot_id = (slot_id +1) % m_num_slots;
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::reader_exit(uint64_t slot_id) const noexcept {
+    m_slots[slot_id].m_epoch.store(0, std::memory_order_release);
+}
+
+template<typename KeyType, typename Layout>
+template<typename Fn>
+auto ConcurrentStaticIndex<KeyType, Layout>::read(Fn&& fn) const {
+    // release the slot even if fn throws
+    struct Guard {
+        const ConcurrentStaticIndex* m_instance;
+        uint64_t m_slot_id;
+        ~Guard(){ m_instance->reader_exit(m_slot_id); }
+    } guard { this, reader_enter() };
+
+    const Index* index = m_current.load(std::memory_order_seq_cst);
+    return fn(*index);
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::publish(std::unique_ptr<Index> index){
+    if(index.get() == nullptr) throw std::invalid_argument("Null index");
+    std::scoped_lock<std::mutex> lock(m_mutex_writers);
+
+    Index* previous = m_current.exchange(index.release(), std::memory_order_seq_cst);
+    // readers that announce an epoch greater than this one have loaded the new index
+    uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    m_retired.push_back(RetiredIndex{ previous, epoch });
+
+    reclaim_unsafe();
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads){
+    std::unique_ptr<Index> index { new Index(m_node_size, num_entries) };
+    index->build(separators, num_entries, num_threads);
+    publish(std::move(index));
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::reclaim(){
+    std::scoped_lock<std::mutex> lock(m_mutex_writers);
+    reclaim_unsafe();
+    return m_retired.size();
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::reclaim_unsafe(){
+    if(m_retired.empty()) return;
+
+    // the oldest epoch announced by the active readers
+    uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+    for(uint64_t i = 0; i < m_num_slots; i++){
+        uint64_t epoch = m_slots[i].m_epoch.load(std::memory_order_seq_cst);
+        if(epoch != 0 && epoch < min_epoch){ min_epoch = epoch; }
+    }
+
+    uint64_t j = 0;
+    for(uint64_t i = 0; i < m_retired.size(); i++){
+        if(m_retired[i].m_epoch < min_epoch){
+            delete m_retired[i].m_index;
+        } else {
+            m_retired[j++] = m_retired[i];
+        }
+    }
+    m_retired.resize(j);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::find_lt(KeyType key) const noexcept {
+    return read([key](const Index& index){ return index.find_lt(key); });
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::find_lte(KeyType key) const noexcept {
+    return read([key](const Index& index){ return index.find_lte(key); });
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::find_lte_first(KeyType key) const noexcept {
+    return read([key](const Index& index){ return index.find_lte_first(key); });
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::find_lte_last(KeyType key) const noexcept {
+    return read([key](const Index& index){ return index.find_lte_last(key); });
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    read([=](const Index& index){ index.find_lt(keys, num_keys, out); });
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    read([=](const Index& index){ index.find_lte(keys, num_keys, out); });
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    read([=](const Index& index){ index.find_lte_first(keys, num_keys, out); });
+}
+
+template<typename KeyType, typename Layout>
+void ConcurrentStaticIndex<KeyType, Layout>::find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    read([=](const Index& index){ index.find_lte_last(keys, num_keys, out); });
+}
+
+template<typename KeyType, typename Layout>
+KeyType ConcurrentStaticIndex<KeyType, Layout>::minimum() const noexcept {
+    return read([](const Index& index){ return index.minimum(); });
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ConcurrentStaticIndex<KeyType, Layout>::node_size() const noexcept {
+    return m_node_size;
+}
+
+template<typename KeyType, typename Layout>
+constexpr uint64_t ConcurrentStaticIndex<KeyType, Layout>::num_reader_slots() noexcept {
+    return m_num_slots;
+}
+
+} // namespace common
+
+#endif //COMMON_CONCURRENT_STATIC_INDEX_HPP
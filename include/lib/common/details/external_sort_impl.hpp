@@ -0,0 +1,259 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef COMMON_EXTERNAL_SORT_IMPL_HPP
+#define COMMON_EXTERNAL_SORT_IMPL_HPP
+
+#include <algorithm>
+#include <cinttypes>
+#include <memory>
+#include <queue>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../error.hpp"
+#include "../sorting.hpp"
+#include "../thread_pool.hpp"
+
+namespace common::details::external_sort {
+
+    // The minimum size, in bytes, of the buffers used to read and write the runs. The memory budget can be exceeded
+    // to respect this threshold, when the number of runs is very high.
+    constexpr uint64_t min_buffer_sz = 1ull << 16;
+
+    /**
+     * A file accessed through positional reads and writes (pread/pwrite). Implemented in src/external_sort.cpp
+     */
+    class File {
+        int m_fd; // the file descriptor
+        std::string m_path; // the path to the file, for the error messages
+
+    public:
+        enum class Mode {
+            READ, // open an existing file in read only mode
+            WRITE, // create or truncate the file, in write only mode
+            TEMPORARY, // create an anonymous file in the given directory, removed once closed
+        };
+
+        /**
+         * Open the given file. In the TEMPORARY mode, the path is the directory where to create the file. An
+         * empty path means the directory given by the environment variable TMPDIR, or /tmp otherwise.
+         */
+        File(const std::string& path, Mode mode);
+
+        /**
+         * Close the file
+         */
+        ~File();
+
+        File(File&& other) noexcept;
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        /**
+         * Retrieve the size of the file, in bytes
+         */
+        uint64_t size() const;
+
+        /**
+         * Read up to `num_bytes' starting from the given offset. Return the number of bytes read, less than `num_bytes'
+         * only at the end of the file.
+         */
+        uint64_t read(void* buffer, uint64_t num_bytes, uint64_t offset) const;
+
+        /**
+         * Write `num_bytes' at the given offset
+         */
+        void write(const void* buffer, uint64_t num_bytes, uint64_t offset);
+    };
+
+    // A sorted run stored in a file, read sequentially with a read-ahead buffer: while the elements of the current
+    // buffer are consumed, the next chunk is fetched by a task in the library thread pool
+    template<typename T>
+    class RunReader {
+        const File* m_file; // the file storing the run
+        const uint64_t m_file_offset; // the offset in the file where the run starts, in bytes
+        const uint64_t m_num_elements; // total number of elements in the run
+        const uint64_t m_buffer_capacity; // capacity of each buffer, in number of elements
+        uint64_t m_num_requested = 0; // number of elements read so far or being read by m_pending
+        std::unique_ptr<T[]> m_current; // the elements being consumed
+        std::unique_ptr<T[]> m_next; // the elements being fetched
+        uint64_t m_current_sz = 0; // number of elements in m_current
+        uint64_t m_next_sz = 0; // number of elements being fetched into m_next, 0 if the run is exhausted
+        uint64_t m_position = 0; // next element to consume in m_current
+        std::unique_ptr<TaskGroup> m_pending; // the fetch in progress into m_next. Declared last, to wait for it before releasing the buffers
+
+        // start fetching the next chunk, if any
+        void prefetch(){
+            m_next_sz = std::min(m_buffer_capacity, m_num_elements - m_num_requested);
+            if(m_next_sz == 0) return;
+            uint64_t count = m_next_sz;
+            uint64_t offset = m_file_offset + m_num_requested * sizeof(T);
+            const File* file = m_file; T* buffer = m_next.get();
+            m_pending->run([file, buffer, count, offset](){
+                uint64_t num_bytes = file->read(buffer, count * sizeof(T), offset);
+                if(num_bytes != count * sizeof(T)) ERROR("Unexpected end of file in a sorted run");
+            });
+            m_num_requested += count;
+        }
+
+    public:
+        RunReader(const File* file, uint64_t file_offset, uint64_t num_elements, uint64_t buffer_capacity) :
+                m_file(file), m_file_offset(file_offset), m_num_elements(num_elements), m_buffer_capacity(buffer_capacity),
+                m_current(new T[buffer_capacity]), m_next(new T[buffer_capacity]), m_pending(new TaskGroup()) {
+            prefetch();
+            refill();
+        }
+
+        // whether all elements have been consumed
+        bool empty() const { return m_position >= m_current_sz; }
+
+        // the next element to consume
+        const T& top() const { return m_current[m_position]; }
+
+        // consume the current element
+        void pop(){
+            m_position++;
+            if(m_position == m_current_sz){ refill(); }
+        }
+
+        // wait for the chunk being fetched and start fetching the next one. Return false if the run is exhausted
+        bool refill(){
+            m_position = m_current_sz = 0;
+            if(m_next_sz == 0) return false;
+            m_pending->wait();
+            m_current_sz = m_next_sz;
+            std::swap(m_current, m_next);
+            prefetch();
+            return true;
+        }
+    };
+
+    // A sequential writer to a file, with write-behind: a full buffer is written by a task in the library thread pool
+    // while the next buffer is being filled
+    template<typename T>
+    class Writer {
+        File* m_file; // the output file
+        uint64_t m_file_offset; // where to write the next buffer, in bytes
+        const uint64_t m_buffer_capacity; // capacity of each buffer, in number of elements
+        std::unique_ptr<T[]> m_current; // the buffer being filled
+        std::unique_ptr<T[]> m_flushing; // the buffer being written
+        uint64_t m_current_sz = 0; // number of elements in m_current
+        TaskGroup m_pending; // the write in progress of m_flushing. Declared last, to wait for it before releasing the buffers
+
+    public:
+        Writer(File* file, uint64_t buffer_capacity) : m_file(file), m_file_offset(0), m_buffer_capacity(buffer_capacity),
+                m_current(new T[buffer_capacity]), m_flushing(new T[buffer_capacity]) { }
+
+        // append an element to the output
+        void append(const T& element){
+            m_current[m_current_sz++] = element;
+            if(m_current_sz == m_buffer_capacity){ flush(); }
+        }
+
+        // write the elements in the current buffer
+        void flush(){
+            m_pending.wait(); // wait for the previous buffer
+            if(m_current_sz == 0) return;
+            std::swap(m_current, m_flushing);
+            File* file = m_file; const T* buffer = m_flushing.get();
+            uint64_t num_bytes = m_current_sz * sizeof(T); uint64_t offset = m_file_offset;
+            m_pending.run([file, buffer, num_bytes, offset](){ file->write(buffer, num_bytes, offset); });
+            m_file_offset += num_bytes;
+            m_current_sz = 0;
+        }
+
+        // write all pending elements and wait for the completion
+        void close(){
+            flush();
+            m_pending.wait();
+        }
+    };
+
+    // Merge the sorted runs into the output, with a binary heap
+    template<typename T, typename FunctionLess>
+    void merge(std::vector<RunReader<T>>& runs, Writer<T>& output, const FunctionLess& fn_less){
+        // the heap is a max heap, invert the comparator to extract the minimum
+        auto fn_heap = [&runs, &fn_less](uint64_t a, uint64_t b){ return fn_less(runs[b].top(), runs[a].top()); };
+        std::priority_queue<uint64_t, std::vector<uint64_t>, decltype(fn_heap)> heap(fn_heap);
+        for(uint64_t i = 0; i < runs.size(); i++){
+            if(!runs[i].empty()) heap.push(i);
+        }
+
+        while(!heap.empty()){
+            uint64_t run = heap.top();
+            heap.pop();
+            output.append(runs[run].top());
+            runs[run].pop();
+            if(!runs[run].empty()) heap.push(run);
+        }
+    }
+
+    template<typename T, typename FunctionLess>
+    void implementation(const std::string& path_input, const std::string& path_output, uint64_t memory_budget, const FunctionLess& fn_less, const std::string& temporary_directory){
+        static_assert(std::is_trivially_copyable_v<T>, "The elements are read and written as raw bytes");
+        File input { path_input, File::Mode::READ };
+        const uint64_t input_sz = input.size();
+        if(input_sz % sizeof(T) != 0) INVALID_ARGUMENT("The size of the file " << path_input << " is not a multiple of the size of the elements");
+        const uint64_t num_elements = input_sz / sizeof(T);
+
+        // the in-memory sort requires an auxiliary buffer as large as the run
+        const uint64_t run_capacity = std::max<uint64_t>(memory_budget / (2 * sizeof(T)), min_buffer_sz / sizeof(T));
+
+        // 1. sort the runs
+        std::vector<File> run_files;
+        std::vector<uint64_t> run_sizes;
+        { // restrict the scope of the buffer
+            std::unique_ptr<T[]> buffer { new T[std::min(run_capacity, std::max<uint64_t>(num_elements, 1))] };
+            for(uint64_t start = 0; start < num_elements; start += run_capacity){
+                uint64_t count = std::min(run_capacity, num_elements - start);
+                uint64_t num_bytes = input.read(buffer.get(), count * sizeof(T), start * sizeof(T));
+                if(num_bytes != count * sizeof(T)) ERROR("Unexpected end of file: " << path_input);
+                common::sort(buffer.get(), count, fn_less);
+
+                if(num_elements <= run_capacity){ // single run, no need to merge
+                    File output { path_output, File::Mode::WRITE };
+                    output.write(buffer.get(), count * sizeof(T), 0);
+                    return;
+                }
+
+                run_files.emplace_back(temporary_directory, File::Mode::TEMPORARY);
+                run_files.back().write(buffer.get(), count * sizeof(T), 0);
+                run_sizes.push_back(count);
+            }
+        }
+
+        // 2. k-way merge. Two buffers for each run and two buffers for the output. Only create the output now, as it
+        // may overwrite the input
+        File output { path_output, File::Mode::WRITE };
+        const uint64_t num_runs = run_files.size();
+        if(num_runs == 0) return; // empty input
+        const uint64_t buffer_capacity = std::max<uint64_t>(memory_budget / ((2 * num_runs + 2) * sizeof(T)), std::max<uint64_t>(1, min_buffer_sz / sizeof(T)));
+        std::vector<RunReader<T>> runs;
+        runs.reserve(num_runs);
+        for(uint64_t i = 0; i < num_runs; i++){
+            runs.emplace_back(&run_files[i], 0, run_sizes[i], buffer_capacity);
+        }
+        Writer<T> writer { &output, buffer_capacity };
+        merge(runs, writer, fn_less);
+        writer.close();
+    }
+
+} // namespace
+
+#endif //COMMON_EXTERNAL_SORT_IMPL_HPP
@@ -0,0 +1,211 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef COMMON_MERGE_IMPL_HPP
+#define COMMON_MERGE_IMPL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "sorting_impl.hpp"
+
+namespace common::details::merge {
+
+    /**
+     * A tournament tree to merge k sorted sequences, where each internal node stores the loser of the match among its
+     * children and the winner (the minimum) is kept apart. After the winner is consumed, only the path from its leaf
+     * to the root is replayed, with log(k) comparisons, each one against a single loser.
+     *
+     * Ties are broken by the index of the sequence, thus the merge is stable.
+     */
+    template<typename T, typename FunctionLess>
+    class LoserTree {
+        const FunctionLess& m_fn_less; // the comparator
+        const uint64_t m_num_leaves; // the number of sequences, rounded up to the next power of 2
+        std::unique_ptr<const T*[]> m_current; // the next element of each sequence
+        std::unique_ptr<const T*[]> m_end; // the end of each sequence
+        std::unique_ptr<uint64_t[]> m_losers; // m_losers[0] is the winner, m_losers[1..m_num_leaves) the losers of the internal nodes
+
+        // whether the element in the sequence a is less than the element in the sequence b, with exhausted sequences as +infinity
+        bool less(uint64_t a, uint64_t b) const {
+            if(m_current[a] == m_end[a]) return false;
+            if(m_current[b] == m_end[b]) return true;
+            if(m_fn_less(*m_current[a], *m_current[b])) return true;
+            if(m_fn_less(*m_current[b], *m_current[a])) return false;
+            return a < b;
+        }
+
+        // play the matches of the subtree rooted in the given node, store the losers and return the winner
+        uint64_t initialise(uint64_t node){
+            if(node >= m_num_leaves) return node - m_num_leaves; // leaf
+            uint64_t left = initialise(2 * node);
+            uint64_t right = initialise(2 * node +1);
+            if(less(right, left)) std::swap(left, right);
+            m_losers[node] = right;
+            return left;
+        }
+
+    public:
+        /**
+         * Initialise the tree with the sequences [starts[i], ends[i]), i in [0, num_sequences)
+         */
+        LoserTree(const T* const* starts, const T* const* ends, uint64_t num_sequences, const FunctionLess& fn_less) :
+                m_fn_less(fn_less), m_num_leaves(round_leaves(num_sequences)), m_current(new const T*[m_num_leaves]),
+                m_end(new const T*[m_num_leaves]), m_losers(new uint64_t[m_num_leaves]) {
+            for(uint64_t i = 0; i < m_num_leaves; i++){
+                m_current[i] = (i < num_sequences) ? starts[i] : nullptr;
+                m_end[i] = (i < num_sequences) ? ends[i] : nullptr; // padding, empty sequences
+            }
+            m_losers[0] = initialise(1);
+        }
+
+        /**
+         * Whether all sequences have been exhausted
+         */
+        bool empty() const {
+            uint64_t winner = m_losers[0];
+            return m_current[winner] == m_end[winner];
+        }
+
+        /**
+         * Retrieve the minimum among the next elements of all sequences
+         */
+        const T& top() const {
+            return *m_current[m_losers[0]];
+        }
+
+        /**
+         * Consume the minimum and replay the matches on its path
+         */
+        void pop(){
+            uint64_t winner = m_losers[0];
+            m_current[winner]++;
+            for(uint64_t node = (winner + m_num_leaves) / 2; node > 0; node /= 2){
+                if(less(m_losers[node], winner)){ std::swap(m_losers[node], winner); }
+            }
+            m_losers[0] = winner;
+        }
+
+        // the number of leaves for the given number of sequences, a power of 2
+        static uint64_t round_leaves(uint64_t num_sequences){
+            uint64_t result = 1;
+            while(result < num_sequences) result <<= 1;
+            return result;
+        }
+    };
+
+    // Multi-sequence selection. Find the positions splits[i] in each sorted sequence such that the elements before the
+    // splits are exactly the `rank' smallest elements of the union, ties broken by the index of the sequence. At each
+    // step, the middle element of the widest candidate range is taken as pivot and ranked in every sequence with a
+    // binary search; the candidate ranges are then narrowed depending on whether the pivot is below or above `rank'.
+    template<typename T, typename FunctionLess>
+    void select(const T* const* sequences, const uint64_t* sizes, uint64_t num_sequences, uint64_t rank, const FunctionLess& fn_less, uint64_t* splits){
+        std::unique_ptr<uint64_t[]> ptr_hi { new uint64_t[num_sequences] };
+        std::unique_ptr<uint64_t[]> ptr_positions { new uint64_t[num_sequences] };
+        uint64_t* lo = splits; // the split of each sequence is in [lo, hi]
+        uint64_t* hi = ptr_hi.get();
+        uint64_t* positions = ptr_positions.get();
+        for(uint64_t i = 0; i < num_sequences; i++){ lo[i] = 0; hi[i] = sizes[i]; }
+
+        while(true){
+            // the widest candidate range
+            uint64_t j = 0;
+            for(uint64_t i = 1; i < num_sequences; i++){
+                if(hi[i] - lo[i] > hi[j] - lo[j]) j = i;
+            }
+            if(num_sequences == 0 || hi[j] == lo[j]) return; // all splits are fixed
+
+            // rank the pivot
+            const uint64_t m = lo[j] + (hi[j] - lo[j]) / 2;
+            const T& pivot = sequences[j][m];
+            uint64_t total = 0;
+            for(uint64_t i = 0; i < num_sequences; i++){
+                const T* start = sequences[i] + lo[i];
+                const T* end = sequences[i] + hi[i];
+                if(i < j){ // the elements equal to the pivot in the previous sequences come first
+                    positions[i] = std::upper_bound(start, end, pivot, fn_less) - sequences[i];
+                } else if(i == j){
+                    positions[i] = m;
+                } else {
+                    positions[i] = std::lower_bound(start, end, pivot, fn_less) - sequences[i];
+                }
+                total += positions[i];
+            }
+
+            if(total < rank){ // the pivot and all elements before it are selected
+                for(uint64_t i = 0; i < num_sequences; i++){ lo[i] = positions[i]; }
+                lo[j] = m +1;
+            } else { // the pivot is not selected, nor the elements after it
+                for(uint64_t i = 0; i < num_sequences; i++){ hi[i] = positions[i]; }
+                if(total == rank){
+                    for(uint64_t i = 0; i < num_sequences; i++){ lo[i] = positions[i]; }
+                    return;
+                }
+            }
+        }
+    }
+
+    // Merge the sorted sequences into the output, in parallel. The output is split into equal ranges, one for each thread;
+    // each thread finds the start of its range in every sequence with a multi-sequence selection, then merges its range
+    // with a loser tree.
+    template<typename T, typename FunctionLess>
+    void implementation(const T* const* sequences, const uint64_t* sizes, uint64_t num_sequences, T* output, const FunctionLess& fn_less,
+            uint64_t num_threads = ThreadPool::global().num_threads()){
+        uint64_t output_sz = 0;
+        for(uint64_t i = 0; i < num_sequences; i++){ output_sz += sizes[i]; }
+        num_threads = std::max<uint64_t>(1, std::min<uint64_t>(num_threads, output_sz / sorting::min_elements_per_thread));
+
+        // splits[t * num_sequences + i] is where the thread t starts reading the sequence i
+        std::unique_ptr<uint64_t[]> ptr_splits { new uint64_t[(num_threads +1) * num_sequences] };
+        uint64_t* splits = ptr_splits.get();
+        for(uint64_t i = 0; i < num_sequences; i++){
+            splits[i] = 0;
+            splits[num_threads * num_sequences + i] = sizes[i];
+        }
+
+        sorting::parallel_for(num_threads, [&](uint64_t thread_id){
+            const uint64_t start = output_sz * thread_id / num_threads;
+            if(thread_id > 0){ select(sequences, sizes, num_sequences, start, fn_less, splits + thread_id * num_sequences); }
+        });
+
+        sorting::parallel_for(num_threads, [&](uint64_t thread_id){
+            std::unique_ptr<const T*[]> starts { new const T*[num_sequences] };
+            std::unique_ptr<const T*[]> ends { new const T*[num_sequences] };
+            for(uint64_t i = 0; i < num_sequences; i++){
+                starts[i] = sequences[i] + splits[thread_id * num_sequences + i];
+                ends[i] = sequences[i] + splits[(thread_id +1) * num_sequences + i];
+            }
+
+            T* out = output + output_sz * thread_id / num_threads;
+            if(num_sequences == 1){
+                std::copy(starts[0], ends[0], out);
+            } else if(num_sequences == 2){
+                std::merge(starts[0], ends[0], starts[1], ends[1], out, fn_less);
+            } else if(num_sequences > 2) {
+                LoserTree<T, FunctionLess> tree(starts.get(), ends.get(), num_sequences, fn_less);
+                while(!tree.empty()){
+                    *(out++) = tree.top();
+                    tree.pop();
+                }
+            }
+        });
+    }
+
+} // namespace
+
+#endif //COMMON_MERGE_IMPL_HPP
@@ -18,8 +18,15 @@
 #ifndef COMMON_SAMPLING_IMPL_HPP
 #define COMMON_SAMPLING_IMPL_HPP
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
+#include <limits>
 #include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../thread_pool.hpp"
 
 namespace common::details::sampling {
 
@@ -35,7 +42,7 @@ namespace common::details::sampling {
     };
 
     // Vitter J. S. An efficient algorithm for sequential random sampling. Rapports de Recherche N* 624. 1987
-    int64_t next(RandomGenerator& dblrand, int64_t previous_index, int64_t* m_, int64_t* N_){
+    inline int64_t next(RandomGenerator& dblrand, int64_t previous_index, int64_t* m_, int64_t* N_){
         // Code extrapolated and adapted from the old randomgen utility.
         // The following is legacy code, I trust it works as it worked 4 years ago.
         int64_t N = *N_;
@@ -94,22 +101,260 @@ namespace common::details::sampling {
         return previous_index + S +1;
     }
 
+    // Vitter's Algorithm A, cheaper than D when the samples are dense w.r.t. the input: one random number for each sample
+    inline int64_t next_a(RandomGenerator& rnd, int64_t previous_index, int64_t* m_, int64_t* N_){
+        int64_t N = *N_;
+        int64_t m = *m_;
+
+        double V = rnd();
+        int64_t S = 0;
+        double top = N - m;
+        double Nreal = N;
+        double quot = top / Nreal;
+        while(quot > V){
+            S++; top--; Nreal--;
+            quot = (quot * top) / Nreal;
+        }
+
+        *m_ = m -1;
+        *N_ = N -1 -S;
+        return previous_index + S +1;
+    }
+
+    // Draw the number of samples taken from a chunk of `chunk_sz' elements, when drawing `num_samples' samples out of
+    // `population_sz' elements, from the hypergeometric distribution. Inversion by chop-down search starting from the
+    // mode: the cost is proportional to the standard deviation of the distribution.
+    inline uint64_t hypergeometric(RandomGenerator& rnd, uint64_t num_samples, uint64_t chunk_sz, uint64_t population_sz){
+        const double n = num_samples;
+        const double K = chunk_sz;
+        const double N = population_sz;
+        const int64_t lo = std::max<int64_t>(0, static_cast<int64_t>(num_samples) - static_cast<int64_t>(population_sz - chunk_sz));
+        const int64_t hi = std::min(num_samples, chunk_sz);
+        if(lo == hi) return lo;
+
+        auto log_choose = [](double a, double b){ return std::lgamma(a +1) - std::lgamma(b +1) - std::lgamma(a - b +1); };
+        auto pmf = [&](double k){ return std::exp(log_choose(K, k) + log_choose(N - K, n - k) - log_choose(N, n)); };
+        // p(k+1) / p(k) and p(k-1) / p(k)
+        auto ratio_up = [&](double k){ return ((K - k) * (n - k)) / ((k +1) * (N - K - n + k +1)); };
+        auto ratio_down = [&](double k){ return (k * (N - K - n + k)) / ((K - k +1) * (n - k +1)); };
+
+        const int64_t mode = std::clamp<int64_t>(static_cast<int64_t>(std::floor((n +1) * (K +1) / (N +2))), lo, hi);
+        double U = rnd();
+        const double p_mode = pmf(mode);
+        U -= p_mode;
+        if(U <= 0) return mode;
+
+        int64_t left = mode, right = mode;
+        double p_left = p_mode, p_right = p_mode;
+        while(left > lo || right < hi){
+            // visit the side with the larger probability first
+            double p_next_left = (left > lo) ? p_left * ratio_down(left) : -1;
+            double p_next_right = (right < hi) ? p_right * ratio_up(right) : -1;
+            if(p_next_left >= p_next_right){
+                left--; p_left = p_next_left; U -= p_left;
+                if(U <= 0) return left;
+            } else {
+                right++; p_right = p_next_right; U -= p_right;
+                if(U <= 0) return right;
+            }
+        }
+
+        return mode; // rounding errors
+    }
+
+    // The seed of the random generator for the given chunk, from the splitmix64 finaliser
+    inline uint64_t chunk_seed(uint64_t seed, uint64_t chunk_id){
+        uint64_t z = seed + (chunk_id +1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Sequential sampling of `num_samples' elements from the input, in the order of their position
     template<typename T>
-    void implementation(const T* input, uint64_t input_sz, T* output, uint64_t& num_samples, uint64_t seed){
-        if(num_samples > input_sz) { num_samples = input_sz; } // overflow
+    void sample_chunk(const T* input, uint64_t input_sz, T* output, uint64_t num_samples, RandomGenerator& rnd){
+        if(num_samples == input_sz){ // take everything
+            std::copy(input, input + input_sz, output);
+            return;
+        }
 
-        RandomGenerator rnd{seed};
         int64_t i = 0; // index in the output array
         int64_t k = -1; // the first value that can be generated by the sampling algorithm will start from 0
         int64_t m = num_samples; // total number of samples to generate
         int64_t N = input_sz; // total size of the input
         while(m > 0){
-            k = next(rnd, k, &m, &N);
+            if(m == 1){ // the last sample, uniform in the remaining input
+                k += 1 + std::min<int64_t>(N -1, static_cast<int64_t>(N * rnd()));
+                m = 0;
+            } else if(13 * m >= N){ // dense, as suggested by Vitter
+                k = next_a(rnd, k, &m, &N);
+            } else {
+                k = next(rnd, k, &m, &N);
+            }
 
             output[i] = input[k];
             i++; // next iteration
         }
     }
+
+    // The number of input elements assigned to each chunk. It does not depend on the number of threads, so that the
+    // samples only depend on the seed.
+    constexpr uint64_t chunk_sz = 1ull << 20;
+
+    // Execute fn(chunk_id) for each chunk, in parallel
+    template<typename Function>
+    void for_each_chunk(uint64_t num_chunks, const Function& fn){
+        if(num_chunks == 1){
+            fn(0);
+        } else if(num_chunks > 1){
+            TaskGroup group;
+            for(uint64_t chunk_id = 0; chunk_id < num_chunks; chunk_id++){
+                group.run([&fn, chunk_id](){ fn(chunk_id); });
+            }
+            group.wait(); // wait for all the tasks to complete
+        }
+    }
+
+    template<typename T>
+    void implementation(const T* input, uint64_t input_sz, T* output, uint64_t& num_samples, uint64_t seed){
+        if(num_samples > input_sz) { num_samples = input_sz; } // overflow
+        if(num_samples == 0) return;
+        const uint64_t num_chunks = (input_sz + chunk_sz -1) / chunk_sz;
+
+        // draw the number of samples of each chunk from the multivariate hypergeometric distribution, as a sequence
+        // of conditional univariate draws
+        std::vector<uint64_t> chunk_samples(num_chunks);
+        std::vector<uint64_t> chunk_offsets(num_chunks); // prefix sum of chunk_samples, the position in the output
+        RandomGenerator rnd{seed};
+        uint64_t population_sz = input_sz;
+        uint64_t samples_left = num_samples;
+        for(uint64_t chunk_id = 0; chunk_id < num_chunks; chunk_id++){
+            uint64_t size = std::min(chunk_sz, population_sz);
+            uint64_t count = (chunk_id == num_chunks -1) ? samples_left : hypergeometric(rnd, samples_left, size, population_sz);
+            chunk_samples[chunk_id] = count;
+            chunk_offsets[chunk_id] = num_samples - samples_left;
+            population_sz -= size;
+            samples_left -= count;
+        }
+
+        // sample each chunk with its own random generator
+        auto sample = [&](uint64_t chunk_id){
+            RandomGenerator chunk_rnd { chunk_seed(seed, chunk_id) };
+            uint64_t start = chunk_id * chunk_sz;
+            uint64_t size = std::min(chunk_sz, input_sz - start);
+            sample_chunk(input + start, size, output + chunk_offsets[chunk_id], chunk_samples[chunk_id], chunk_rnd);
+        };
+
+        for_each_chunk(num_chunks, sample);
+    }
+
+    /**
+     * A bucket of an alias table: the probability to select the element of the bucket, or otherwise its alias
+     */
+    struct AliasBucket {
+        double m_probability;
+        uint64_t m_alias;
+    };
+
+    // The number of elements in each block of an AliasTable
+    constexpr uint64_t alias_block_sz = 1ull << 16;
+
+    // Check the given weight is valid and convert it
+    template<typename W>
+    double weight(W value){
+        double result = static_cast<double>(value);
+        if(!(result >= 0) || std::isinf(result)) throw std::invalid_argument("Invalid weight: it must be finite and not negative");
+        return result;
+    }
+
+    // Build the alias table of the given weights with Vose's method, in O(num_weights) time. The total is the sum of the weights.
+    template<typename W>
+    void build_alias(const W* weights, uint64_t num_weights, double total, AliasBucket* table){
+        std::vector<uint64_t> small, large; // the buckets whose scaled weight is below or above the average (1)
+        for(uint64_t i = 0; i < num_weights; i++){
+            table[i].m_probability = weight(weights[i]) * num_weights / total;
+            table[i].m_alias = i;
+            if(table[i].m_probability < 1){ small.push_back(i); } else { large.push_back(i); }
+        }
+
+        while(!small.empty() && !large.empty()){
+            uint64_t s = small.back(); small.pop_back();
+            uint64_t l = large.back();
+            table[s].m_alias = l; // fill the bucket of s with l
+            table[l].m_probability -= 1 - table[s].m_probability;
+            if(table[l].m_probability < 1){ large.pop_back(); small.push_back(l); }
+        }
+
+        // rounding errors
+        for(uint64_t i : small){ table[i].m_probability = 1; }
+        for(uint64_t i : large){ table[i].m_probability = 1; }
+    }
+
+    // Select a bucket of an alias table with a single uniform number in [0, 1)
+    inline uint64_t draw_alias(const AliasBucket* table, uint64_t table_sz, double u){
+        double x = u * table_sz;
+        uint64_t i = std::min<uint64_t>(table_sz -1, static_cast<uint64_t>(x));
+        return (x - i < table[i].m_probability) ? i : table[i].m_alias;
+    }
+
+    // A candidate for the weighted sampling without replacement, the smaller the key, the higher the priority
+    struct WeightedCandidate {
+        double m_key;
+        uint64_t m_position;
+
+        bool operator<(const WeightedCandidate& other) const {
+            return m_key < other.m_key || (m_key == other.m_key && m_position < other.m_position);
+        }
+    };
+
+    // Retain only the `k' candidates with the smallest keys
+    inline void top_k(std::vector<WeightedCandidate>& candidates, uint64_t k){
+        if(candidates.size() > k){
+            std::nth_element(candidates.begin(), candidates.begin() + k, candidates.end());
+            candidates.resize(k);
+        }
+    }
+
+    // Efraimidis and Spirakis' method: assign to each element the key E/w, with E following an exponential distribution,
+    // and select the elements with the smallest keys
+    template<typename T, typename W>
+    void weighted_implementation(const T* input, const W* weights, uint64_t input_sz, T* output, uint64_t& num_samples, uint64_t seed){
+        if(num_samples > input_sz) { num_samples = input_sz; } // overflow
+        if(num_samples == 0) return;
+        const uint64_t num_chunks = (input_sz + chunk_sz -1) / chunk_sz;
+
+        // select the top-k of each chunk
+        std::vector<std::vector<WeightedCandidate>> chunk_candidates(num_chunks);
+        for_each_chunk(num_chunks, [&](uint64_t chunk_id){
+            RandomGenerator rnd { chunk_seed(seed, chunk_id) };
+            std::vector<WeightedCandidate>& candidates = chunk_candidates[chunk_id];
+            const uint64_t start = chunk_id * chunk_sz;
+            const uint64_t end = std::min(start + chunk_sz, input_sz);
+            for(uint64_t i = start; i < end; i++){
+                double w = weight(weights[i]);
+                if(w == 0) continue; // never selected
+                candidates.push_back(WeightedCandidate{ -std::log(1.0 - rnd()) / w, i });
+            }
+            top_k(candidates, num_samples);
+        });
+
+        // merge the candidates of all chunks
+        std::vector<WeightedCandidate> candidates = std::move(chunk_candidates[0]);
+        for(uint64_t chunk_id = 1; chunk_id < num_chunks; chunk_id++){
+            candidates.insert(candidates.end(), chunk_candidates[chunk_id].begin(), chunk_candidates[chunk_id].end());
+            std::vector<WeightedCandidate>().swap(chunk_candidates[chunk_id]); // release the memory
+        }
+        top_k(candidates, num_samples);
+        num_samples = candidates.size(); // only the elements with a positive weight can be selected
+
+        // output the samples in the order of their position
+        std::sort(candidates.begin(), candidates.end(), [](const WeightedCandidate& a, const WeightedCandidate& b){
+            return a.m_position < b.m_position;
+        });
+        for(uint64_t i = 0; i < num_samples; i++){
+            output[i] = input[candidates[i].m_position];
+        }
+    }
 } // namespace
 
 #endif //COMMON_SAMPLING_IMPL_HPP
@@ -19,72 +19,290 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <future>
 #include <memory>
+#include <new> // placement new
 #include <thread>
 #include <vector>
 
 #include "../sampling.hpp"
+#include "../thread_pool.hpp"
+
+namespace common {
+
+/**
+ * Diagnostics on the execution of common::sort, to detect skewed inputs
+ */
+struct SortStatistics {
+    uint64_t m_num_elements = 0; // the number of elements sorted
+    uint64_t m_num_samples = 0; // the number of samples drawn from the input
+    uint64_t m_num_splitters = 0; // the number of unique splitters selected among the samples
+    uint64_t m_num_buckets = 0; // the number of buckets, including the equality buckets
+    uint64_t m_num_threads = 0; // the number of threads partitioning the input
+    bool m_equality_buckets = false; // whether the elements equal to the splitters have been placed into their own bucket
+    uint64_t m_num_equal_elements = 0; // the number of elements in the equality buckets, that did not need to be sorted
+    uint64_t m_largest_bucket = 0; // the size of the largest bucket to sort, i.e. excluding the equality buckets
+    double m_imbalance = 0; // the size of the largest bucket, relative to a perfect split of the input among the requested splitters
+};
+
+} // namespace common
 
 namespace common::details::sorting {
 
-    // Partition the `array' according to the given samples
+    // Minimum number of elements assigned to each thread in the partitioning phase
+    constexpr uint64_t min_elements_per_thread = 1ull << 14;
+
+    // Buckets smaller than this threshold are sorted by the thread that found them, rather than in a new task
+    constexpr uint64_t min_elements_per_task = 1ull << 12;
+
+    // The number of samples drawn for each splitter
+    constexpr uint64_t oversampling_factor = 16;
+
+    // Execute fn(task_id) for each task in [0, num_tasks), in parallel. The first task is executed by the calling thread
+    template<typename Function>
+    void parallel_for(uint64_t num_tasks, const Function& fn){
+        TaskGroup group;
+        for(uint64_t task_id = 1; task_id < num_tasks; task_id++){
+            group.run([&fn, task_id](){ fn(task_id); });
+        }
+        if(num_tasks > 0){ fn(0); }
+        group.wait(); // wait for all the tasks to complete
+    }
+
+    // Sort the given range. If it is larger than `max_task_sz', recursively split it around a pivot, sorting the
+    // lower part in a new task of the group
     template<typename T, typename FunctionLess>
-    void partition(T*  __restrict array, uint64_t array_sz, const FunctionLess& fn_less, const T* __restrict samples, uint64_t* __restrict intervals, uint64_t num_samples) {
-        for(uint64_t i = 0; i < array_sz; i++){
-            int64_t k = num_samples -1;
-            uint64_t position = i;
-            while(k >= 0 && fn_less(array[position], samples[k]) ){
-                if(position > intervals[k]){
-                    std::swap(array[position], array[intervals[k]]);
-                    position = intervals[k];
-                }
+    void sort_recursive(T* array, uint64_t array_sz, const FunctionLess& fn_less, TaskGroup& group, uint64_t max_task_sz){
+        while(array_sz > max_task_sz){
+            // median of three
+            const T& a = array[0]; const T& b = array[array_sz /2]; const T& c = array[array_sz -1];
+            const T pivot = fn_less(a, b) ? (fn_less(b, c) ? b : (fn_less(a, c) ? c : a)) : (fn_less(a, c) ? a : (fn_less(b, c) ? c : b));
+
+            // [array, mid1) < pivot, [mid1, mid2) == pivot, [mid2, array + array_sz) > pivot
+            T* mid1 = std::partition(array, array + array_sz, [&](const T& e){ return fn_less(e, pivot); });
+            T* mid2 = std::partition(mid1, array + array_sz, [&](const T& e){ return !fn_less(pivot, e); });
+
+            uint64_t lower_sz = mid1 - array;
+            if(lower_sz > 0){
+                group.run([array, lower_sz, &fn_less, &group, max_task_sz](){ sort_recursive(array, lower_sz, fn_less, group, max_task_sz); });
+            }
+            array_sz -= (mid2 - array);
+            array = mid2;
+        }
+
+        std::sort(array, array + array_sz, fn_less);
+    }
+
+    // Retrieve the bucket of the given element. Let i be the number of splitters less than or equal to the element. Without
+    // equality buckets, the bucket is i. With equality buckets, the bucket 2i -1 contains the elements equal to the splitter
+    // i -1 and the bucket 2i the elements strictly between the splitters i -1 and i.
+    template<typename T, typename FunctionLess>
+    uint64_t classify(const T& element, const FunctionLess& fn_less, const T* __restrict splitters, uint64_t num_splitters, bool equality_buckets){
+        uint64_t i = std::upper_bound(splitters, splitters + num_splitters, element, fn_less) - splitters;
+        if(!equality_buckets){
+            return i;
+        } else {
+            return 2 * i - static_cast<uint64_t>(i > 0 && !fn_less(splitters[i -1], element));
+        }
+    }
+
+    // Retrieve the number of buckets for the given splitters
+    inline uint64_t num_buckets(uint64_t num_splitters, bool equality_buckets){
+        return equality_buckets ? 2 * num_splitters +1 : num_splitters +1;
+    }
+
+    // Partition the `array' according to the given splitters, moving the elements into the buckets of `buffer'. The
+    // buffer is uninitialised storage for `array_sz' elements. On exit, the bucket i spans the positions [buckets[i], buckets[i+1])
+    // of the buffer, the array `buckets' must have a capacity of num_buckets(num_splitters, equality_buckets) +1 entries.
+    // With equality buckets, the splitters must be unique.
+    //
+    // The partitioning runs in three phases. Each thread is assigned a contiguous block of the array:
+    // 1. in parallel, each thread classifies the elements in its block, storing their bucket and counting the elements
+    //    of each bucket in a local histogram;
+    // 2. sequentially, a prefix sum over the histograms determines where each thread writes its elements in each bucket;
+    // 3. in parallel, each thread moves the elements of its block into the buffer.
+    template<typename T, typename FunctionLess>
+    void partition(T* __restrict array, uint64_t array_sz, const FunctionLess& fn_less, const T* __restrict splitters, uint64_t num_splitters,
+            T* __restrict buffer, uint64_t* __restrict buckets, uint64_t num_threads, bool equality_buckets = false){
+        const uint64_t num_buckets = sorting::num_buckets(num_splitters, equality_buckets);
+        const uint64_t block_sz = (array_sz + num_threads -1) / num_threads;
+        std::unique_ptr<uint32_t[]> ptr_oracle { new uint32_t[array_sz] }; // the bucket of each element
+        std::unique_ptr<uint64_t[]> ptr_histograms { new uint64_t[num_threads * num_buckets]() }; // histograms[thread_id * num_buckets + bucket]
+        uint32_t* oracle = ptr_oracle.get();
+        uint64_t* histograms = ptr_histograms.get();
 
-                intervals[k]++;
+        // 1. classify
+        parallel_for(num_threads, [&](uint64_t thread_id){
+            const uint64_t start = std::min(array_sz, thread_id * block_sz);
+            const uint64_t end = std::min(array_sz, start + block_sz);
+            uint64_t* __restrict histogram = histograms + thread_id * num_buckets;
+            for(uint64_t i = start; i < end; i++){
+                uint64_t bucket = classify(array[i], fn_less, splitters, num_splitters, equality_buckets);
+                oracle[i] = static_cast<uint32_t>(bucket);
+                histogram[bucket]++;
+            }
+        });
 
-                // next iteration
-                k--;
+        // 2. prefix sum, bucket major, then thread. The histograms become the offsets where each thread writes
+        uint64_t offset = 0;
+        for(uint64_t bucket = 0; bucket < num_buckets; bucket++){
+            buckets[bucket] = offset;
+            for(uint64_t thread_id = 0; thread_id < num_threads; thread_id++){
+                uint64_t count = histograms[thread_id * num_buckets + bucket];
+                histograms[thread_id * num_buckets + bucket] = offset;
+                offset += count;
             }
         }
+        buckets[num_buckets] = offset;
+
+        // 3. scatter
+        parallel_for(num_threads, [&](uint64_t thread_id){
+            const uint64_t start = std::min(array_sz, thread_id * block_sz);
+            const uint64_t end = std::min(array_sz, start + block_sz);
+            uint64_t* __restrict offsets = histograms + thread_id * num_buckets;
+            for(uint64_t i = start; i < end; i++){
+                new (buffer + offsets[oracle[i]]++) T(std::move(array[i]));
+            }
+        });
+    }
+
+    // Select the splitters among the sorted samples, evenly spaced, and remove the duplicates. Return the number of
+    // unique splitters, stored at the start of `samples'. Set `has_duplicates' if some splitters were repeated.
+    template<typename T, typename FunctionLess>
+    uint64_t select_splitters(T* samples, uint64_t num_samples, uint64_t num_splitters, const FunctionLess& fn_less, bool& has_duplicates){
+        const uint64_t step = num_samples / (num_splitters +1);
+        for(uint64_t i = 0; i < num_splitters; i++){
+            samples[i] = samples[(i +1) * step + (step -1) /2]; // index > i, never overwrites a sample yet to read
+        }
+
+        T* end = std::unique(samples, samples + num_splitters, [&fn_less](const T& a, const T& b){ return !fn_less(a, b) && !fn_less(b, a); });
+        uint64_t num_unique = end - samples;
+        has_duplicates = num_unique < num_splitters;
+        return num_unique;
     }
 
     // Sort the input array
     // Based on the sample sort procedure of Section § 5.7.2 in
     // K. Mehlhorn, P. Sanders, Algorithms and Data Structures. The Basic Toolbox, Springer 2008.
+    // The partitioning phase is parallel, following the classification and distribution steps of
+    // M. Axtmann, S. Witt, D. Ferizovic, P. Sanders, In-place Parallel Super Scalar Samplesort (IPS4o), ESA 2017,
+    // but relying on an auxiliary buffer rather than working in place.
+    //
+    // The splitters are selected out of a larger sample (oversampling), to reduce the variance of the bucket sizes. If
+    // some splitters are repeated, the input has many duplicates and the elements equal to each splitter are placed into
+    // their own bucket (equality bucket), which does not need to be sorted.
     template<typename T, typename FunctionLess>
-    void implementation(T* array, uint64_t array_sz, const FunctionLess& fn_less, uint64_t num_samples = std::thread::hardware_concurrency()){
-        // samples => O(k), k = num samples
-        if(num_samples >= array_sz){ std::sort(array, array + array_sz, fn_less); return; }
+    void implementation(T* array, uint64_t array_sz, const FunctionLess& fn_less, uint64_t num_splitters = std::thread::hardware_concurrency(),
+            SortStatistics* statistics = nullptr){
+        if(statistics != nullptr){ *statistics = SortStatistics{}; statistics->m_num_elements = array_sz; }
+
+        // samples => O(s log s), s = num samples
+        if(num_splitters >= array_sz){ std::sort(array, array + array_sz, fn_less); return; }
+        uint64_t num_samples = std::min<uint64_t>(array_sz, num_splitters * oversampling_factor);
         std::unique_ptr<T[]> ptr_samples { new T[num_samples]() };
-        std::unique_ptr<uint64_t[]> ptr_intervals { new uint64_t[num_samples]() };
         T* samples = ptr_samples.get();
-        uint64_t* intervals = ptr_intervals.get();
         common::random_sample(array, array_sz, samples, num_samples);
         std::sort(samples, samples + num_samples, fn_less);
+        bool equality_buckets = false;
+        const uint64_t num_unique_splitters = select_splitters(samples, num_samples, num_splitters, fn_less, equality_buckets);
+        const uint64_t num_buckets = sorting::num_buckets(num_unique_splitters, equality_buckets);
+        std::unique_ptr<uint64_t[]> ptr_buckets { new uint64_t[num_buckets +1]() };
+        uint64_t* buckets = ptr_buckets.get();
 
-        // sequentially partition the intervals, this is the heavy part of the algorithm => O(n), n = array_sz
-        partition(array, array_sz, fn_less, samples, intervals, num_samples);
-
-        // sort the intervals independently in parallel
-        std::vector<std::future<void>> tasks;
-        uint64_t start = 0; // inclusive
-        for(uint64_t i = 0; i < num_samples; i++){
-            uint64_t end = intervals[i]; // exclusive
-            if(start < end){ // if the interval is not empty
-                tasks.push_back(std::async(std::launch::async, [&array, start, end, &fn_less](){
-                    std::sort(array + start, array + end, fn_less);
-                }));
+        // partition the elements into the buckets of an auxiliary buffer => O(n log k / p), n = array_sz, p = num threads
+        const uint64_t pool_sz = std::max<uint64_t>(1, ThreadPool::global().num_threads());
+        const uint64_t num_threads = std::max<uint64_t>(1, std::min<uint64_t>(pool_sz, array_sz / min_elements_per_thread));
+        std::allocator<T> allocator;
+        T* buffer = allocator.allocate(array_sz);
+        partition(array, array_sz, fn_less, samples, num_unique_splitters, buffer, buckets, num_threads, equality_buckets);
+
+        // move back and sort the buckets independently in parallel. The small buckets are sorted by this thread, the
+        // buckets larger than the fair share of a thread are further split
+        TaskGroup group;
+        const uint64_t max_task_sz = std::max<uint64_t>(min_elements_per_task, array_sz / pool_sz);
+        auto sort_bucket = [array, buffer, &fn_less, &group, max_task_sz](uint64_t start, uint64_t end, bool is_sorted){
+            for(uint64_t i = start; i < end; i++){
+                array[i] = std::move(buffer[i]);
+                buffer[i].~T();
+            }
+            if(!is_sorted){ sort_recursive(array + start, end - start, fn_less, group, max_task_sz); }
+        };
+        for(uint64_t i = 0; i < num_buckets; i++){
+            uint64_t start = buckets[i]; // inclusive
+            uint64_t end = buckets[i +1]; // exclusive
+            bool is_sorted = equality_buckets && (i % 2 == 1); // all elements are equal
+            if(end - start >= min_elements_per_task){
+                group.run([&sort_bucket, start, end, is_sorted](){ sort_bucket(start, end, is_sorted); });
+            } else if(start < end){ // if the interval is not empty
+                sort_bucket(start, end, is_sorted);
             }
-            start = end; // next iteration
         }
-        if(start < array_sz){ // last interval
-            uint64_t end = array_sz;
-            tasks.push_back(std::async(std::launch::async, [&array, start, end, &fn_less](){
-                std::sort(array + start, array + end, fn_less);
-            }));
+
+        // collect the statistics, while the other threads are sorting
+        if(statistics != nullptr){
+            statistics->m_num_samples = num_samples;
+            statistics->m_num_splitters = num_unique_splitters;
+            statistics->m_num_buckets = num_buckets;
+            statistics->m_num_threads = num_threads;
+            statistics->m_equality_buckets = equality_buckets;
+            for(uint64_t i = 0; i < num_buckets; i++){
+                uint64_t bucket_sz = buckets[i +1] - buckets[i];
+                if(equality_buckets && (i % 2 == 1)){
+                    statistics->m_num_equal_elements += bucket_sz;
+                } else {
+                    statistics->m_largest_bucket = std::max(statistics->m_largest_bucket, bucket_sz);
+                }
+            }
+            // the ratio between the largest bucket and the size of a bucket in a perfect split among the splitters
+            statistics->m_imbalance = static_cast<double>(statistics->m_largest_bucket) * (num_splitters +1) / array_sz;
         }
 
-        for(auto& t: tasks){ t.get(); }; // wait for all the tasks to complete
+        group.wait(); // wait for all the tasks to complete
+
+        allocator.deallocate(buffer, array_sz);
+    }
+
+    // Rearrange the array such that the element at position i is the element previously at position permutation[i]. The
+    // elements are gathered in parallel into an auxiliary buffer, then moved back.
+    template<typename T>
+    void apply_permutation(const uint64_t* __restrict permutation, uint64_t array_sz, T* __restrict array){
+        const uint64_t num_threads = std::max<uint64_t>(1, std::min<uint64_t>(ThreadPool::global().num_threads(), array_sz / min_elements_per_thread));
+        const uint64_t block_sz = (array_sz + num_threads -1) / num_threads;
+        std::allocator<T> allocator;
+        T* buffer = allocator.allocate(std::max<uint64_t>(array_sz, 1));
+
+        parallel_for(num_threads, [&](uint64_t thread_id){ // gather
+            const uint64_t start = std::min(array_sz, thread_id * block_sz);
+            const uint64_t end = std::min(array_sz, start + block_sz);
+            for(uint64_t i = start; i < end; i++){ new (buffer + i) T(std::move(array[permutation[i]])); }
+        });
+        parallel_for(num_threads, [&](uint64_t thread_id){ // move back
+            const uint64_t start = std::min(array_sz, thread_id * block_sz);
+            const uint64_t end = std::min(array_sz, start + block_sz);
+            for(uint64_t i = start; i < end; i++){
+                array[i] = std::move(buffer[i]);
+                buffer[i].~T();
+            }
+        });
+
+        allocator.deallocate(buffer, std::max<uint64_t>(array_sz, 1));
+    }
+
+    // Compute the permutation that sorts the keys, using the sample sort over the positions of the keys. Ties are broken by
+    // position, thus the permutation is stable.
+    template<typename T, typename FunctionLess>
+    void argsort(const T* keys, uint64_t num_keys, const FunctionLess& fn_less, uint64_t* permutation){
+        const uint64_t num_threads = std::max<uint64_t>(1, std::min<uint64_t>(ThreadPool::global().num_threads(), num_keys / min_elements_per_thread));
+        const uint64_t block_sz = (num_keys + num_threads -1) / num_threads;
+        parallel_for(num_threads, [&](uint64_t thread_id){
+            const uint64_t start = std::min(num_keys, thread_id * block_sz);
+            const uint64_t end = std::min(num_keys, start + block_sz);
+            for(uint64_t i = start; i < end; i++){ permutation[i] = i; }
+        });
+
+        auto fn_position_less = [keys, &fn_less](uint64_t a, uint64_t b){
+            return fn_less(keys[a], keys[b]) || (!fn_less(keys[b], keys[a]) && a < b);
+        };
+        implementation(permutation, num_keys, fn_position_less);
     }
 
 } // namespace
@@ -0,0 +1,158 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef COMMON_SORTING_RADIX_HPP
+#define COMMON_SORTING_RADIX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <limits>
+#include <memory>
+#include <type_traits>
+
+#include "sorting_impl.hpp"
+
+namespace common::details::sorting::radix {
+
+    // The number of bits sorted in each pass
+    constexpr uint64_t digit_bits = 8;
+
+    // The number of buckets in each pass
+    constexpr uint64_t num_digits = 1ull << digit_bits;
+
+    // Inputs smaller than this threshold are sorted with std::sort
+    constexpr uint64_t min_elements = 1ull << 12;
+
+    // The size, in bytes, of the software write-combining buffer of each thread for each bucket
+    constexpr uint64_t wc_buffer_sz = 64;
+
+    // Whether the radix sort can be used in place of the sample sort, for the given key type and comparator
+    template<typename T, typename FunctionLess>
+    constexpr bool is_applicable = std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+            (std::is_same_v<FunctionLess, std::less<T>> || std::is_same_v<FunctionLess, std::less<>>);
+
+    // Map the key into an unsigned integer with the same order, flipping the sign bit of the signed integers
+    template<typename T>
+    std::make_unsigned_t<T> to_unsigned(T key){
+        using U = std::make_unsigned_t<T>;
+        if constexpr (std::is_signed_v<T>){
+            return static_cast<U>(key) ^ (U{1} << (std::numeric_limits<U>::digits -1));
+        } else {
+            return key;
+        }
+    }
+
+    // Retrieve the digit of the key in the given pass
+    template<typename T>
+    uint64_t digit(T key, uint64_t pass){
+        return static_cast<uint64_t>(to_unsigned(key) >> (pass * digit_bits)) & (num_digits -1);
+    }
+
+    // Move the elements of the block [start, end) of `input' into `output', according to their digit in the given pass.
+    // Offsets is the position in the output where to write the next element for each digit. The elements are first
+    // accumulated in a write-combining buffer of a cache line for each digit, and copied into the output in batches.
+    template<typename T>
+    void scatter(const T* __restrict input, uint64_t start, uint64_t end, T* __restrict output, uint64_t pass, uint64_t* __restrict offsets){
+        constexpr uint64_t wc_capacity = std::max<uint64_t>(1, wc_buffer_sz / sizeof(T)); // elements per buffer
+        std::unique_ptr<T[]> ptr_wc_buffers { new T[num_digits * wc_capacity] };
+        T* __restrict wc_buffers = ptr_wc_buffers.get();
+        uint32_t wc_sizes[num_digits] = {0};
+
+        for(uint64_t i = start; i < end; i++){
+            T key = input[i];
+            uint64_t d = digit(key, pass);
+            T* __restrict wc_buffer = wc_buffers + d * wc_capacity;
+            wc_buffer[wc_sizes[d]++] = key;
+            if(wc_sizes[d] == wc_capacity){ // flush
+                memcpy(output + offsets[d], wc_buffer, wc_capacity * sizeof(T));
+                offsets[d] += wc_capacity;
+                wc_sizes[d] = 0;
+            }
+        }
+
+        for(uint64_t d = 0; d < num_digits; d++){ // flush the remaining elements
+            memcpy(output + offsets[d], wc_buffers + d * wc_capacity, wc_sizes[d] * sizeof(T));
+            offsets[d] += wc_sizes[d];
+        }
+    }
+
+    // Sort the array of integers, as an LSD radix sort with 8-bit digits. Each pass counts the digits in a histogram for
+    // each thread, computes the offsets of each thread in each bucket with a prefix sum, then moves the elements into an
+    // auxiliary buffer. The passes where all keys have the same digit, e.g. the high bytes of small keys, are skipped.
+    template<typename T>
+    void implementation(T* array, uint64_t array_sz, SortStatistics* statistics = nullptr){
+        if(statistics != nullptr){ *statistics = SortStatistics{}; statistics->m_num_elements = array_sz; }
+        if(array_sz < min_elements){ std::sort(array, array + array_sz); return; }
+
+        constexpr uint64_t num_passes = sizeof(T) * 8 / digit_bits;
+        const uint64_t pool_sz = std::max<uint64_t>(1, ThreadPool::global().num_threads());
+        const uint64_t num_threads = std::max<uint64_t>(1, std::min<uint64_t>(pool_sz, array_sz / min_elements_per_thread));
+        const uint64_t block_sz = (array_sz + num_threads -1) / num_threads;
+        std::unique_ptr<uint64_t[]> ptr_histograms { new uint64_t[num_threads * num_digits] }; // histograms[thread_id * num_digits + digit]
+        uint64_t* histograms = ptr_histograms.get();
+        std::unique_ptr<T[]> ptr_buffer { new T[array_sz] };
+        T* input = array;
+        T* output = ptr_buffer.get();
+
+        if(statistics != nullptr){ statistics->m_num_threads = num_threads; statistics->m_num_buckets = num_digits; }
+
+        for(uint64_t pass = 0; pass < num_passes; pass++){
+            // 1. count the digits in each block
+            parallel_for(num_threads, [&](uint64_t thread_id){
+                const uint64_t start = std::min(array_sz, thread_id * block_sz);
+                const uint64_t end = std::min(array_sz, start + block_sz);
+                uint64_t* __restrict histogram = histograms + thread_id * num_digits;
+                std::fill(histogram, histogram + num_digits, 0);
+                for(uint64_t i = start; i < end; i++){ histogram[digit(input[i], pass)]++; }
+            });
+
+            // 2. prefix sum, digit major, then thread. Skip the pass if all keys have the same digit
+            uint64_t offset = 0;
+            bool skip = false;
+            for(uint64_t d = 0; d < num_digits && !skip; d++){
+                uint64_t offset_start = offset;
+                for(uint64_t thread_id = 0; thread_id < num_threads; thread_id++){
+                    uint64_t count = histograms[thread_id * num_digits + d];
+                    histograms[thread_id * num_digits + d] = offset;
+                    offset += count;
+                }
+                skip = (offset - offset_start == array_sz);
+            }
+            if(skip) continue;
+
+            // 3. scatter
+            parallel_for(num_threads, [&](uint64_t thread_id){
+                const uint64_t start = std::min(array_sz, thread_id * block_sz);
+                const uint64_t end = std::min(array_sz, start + block_sz);
+                scatter(input, start, end, output, pass, histograms + thread_id * num_digits);
+            });
+
+            std::swap(input, output);
+        }
+
+        if(input != array){ // odd number of passes, copy back the sorted keys
+            parallel_for(num_threads, [&](uint64_t thread_id){
+                const uint64_t start = std::min(array_sz, thread_id * block_sz);
+                const uint64_t end = std::min(array_sz, start + block_sz);
+                memcpy(array + start, input + start, (end - start) * sizeof(T));
+            });
+        }
+    }
+
+} // namespace
+
+#endif //COMMON_SORTING_RADIX_HPP
@@ -0,0 +1,713 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_STATIC_INDEX_IMPLICIT_HPP
+#define COMMON_STATIC_INDEX_IMPLICIT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "../memory.hpp"
+#include "../static_index.hpp"
+#include "static_index_simd.hpp"
+
+namespace common::details::static_index {
+
+/**
+ * The variants of the method #find
+ */
+enum class Search { LT, LTE, LTE_FIRST, LTE_LAST };
+
+/**
+ * Implementation of the layouts Eytzinger and van Emde Boas for the class StaticIndex. The separator keys of the
+ * entries [1, N) are stored in a perfect search tree, whose slots in excess are padded with the maximum key. As the
+ * tree is perfect, the number of keys smaller than the search key is given by the position reached at the bottom of
+ * the tree, without storing any further metadata.
+ */
+template<typename KeyType, typename Layout>
+class ImplicitTree {
+    static_assert(std::is_same_v<Layout, index_layout::Eytzinger> || std::is_same_v<Layout, index_layout::VanEmdeBoas>, "Invalid layout");
+    constexpr static bool m_is_veb = std::is_same_v<Layout, index_layout::VanEmdeBoas>;
+    constexpr static int m_max_height = 64; // the maximum height of the tree
+    constexpr static uint64_t m_batch_sz = 16; // number of lookups interleaved by the batched traversals
+
+    const uint16_t m_node_size; // number of keys per node + 1, always 2 for the van Emde Boas layout
+    const uint16_t m_btree_node_size; // the node size given on initialisation, that of the B-Tree layout whose semantics are followed
+    int m_height; // the height of the tree
+    uint64_t m_capacity; // the number of entries indexed
+    uint64_t m_num_slots; // the number of slots in m_keys, including the padding
+    KeyType* m_keys; // the container of the keys
+    KeyType m_key_minimum; // the minimum stored in the tree, separator of the entry 0
+    const memory::AllocationPolicy m_allocation_policy; // how to allocate m_keys
+
+    // Eytzinger layout, the id of the first node at each depth
+    uint64_t m_level_start[m_max_height +1];
+
+    // van Emde Boas layout, the recursive subdivision of the tree where each depth is the root of a bottom tree
+    struct VebLevel {
+        int m_top_depth; // the depth of the root of the top tree
+        uint64_t m_top_sz; // the number of nodes in the top tree
+        uint64_t m_bottom_sz; // the number of nodes in each bottom tree
+    };
+    VebLevel m_veb[m_max_height];
+
+    // The position reached while descending the tree
+    struct Cursor {
+        uint64_t m_index; // Eytzinger: the id of the current node, van Emde Boas: the index of the node in breadth-first order, from 1
+        int m_depth; // the depth of the current node
+        KeyType m_successor; // the last key visited greater or equal than the search key
+        std::array<uint64_t, m_is_veb ? m_max_height : 0> m_veb_pos; // van Emde Boas: the position of the visited nodes
+    };
+
+    // Compute the subdivision of the van Emde Boas layout for the subtree rooted at `depth'
+    void init_veb(int depth, int height);
+
+    // Retrieve the position of the given node in the van Emde Boas layout
+    uint64_t veb_position(uint64_t index, int depth) const noexcept;
+
+    // Retrieve the slot of the key with the given rank, in [0, N -1)
+    uint64_t slot(uint64_t rank) const noexcept;
+
+    // Position the cursor at the root of the tree
+    Cursor cursor_root() const noexcept;
+
+    // The keys of the node pointed by the cursor
+    const KeyType* cursor_node(const Cursor& cursor) const noexcept;
+
+    // Move the cursor to the next depth
+    template<bool Inclusive>
+    void cursor_descend(Cursor& cursor, KeyType key) const noexcept;
+
+    // With repeated keys, the entry returned by #find_lte_first depends on the shape of the tree. Retrieve the entry that
+    // the B-Tree layout would return, given the results of #find_lt and #find_lte_last for the same key.
+    uint64_t btree_lte_first(uint64_t position_lt, uint64_t position_lte_last) const noexcept;
+
+    // Retrieve the entry once the cursor reached the bottom of the tree
+    template<Search mode>
+    uint64_t cursor_entry(const Cursor& cursor, KeyType key) const noexcept;
+
+    // Implementation of the methods #find
+    template<Search mode>
+    uint64_t find(KeyType key) const noexcept;
+    template<Search mode>
+    void find(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+
+public:
+    /**
+     * Visit the entries of the tree in order, see StaticIndex::Iterator. The keys are retrieved by their rank,
+     * without descending the tree.
+     */
+    class Iterator {
+        friend class ImplicitTree;
+        const ImplicitTree* m_index; // the index being visited
+        uint64_t m_position; // the current entry
+        KeyType m_key; // the separator key of the current entry
+        KeyType m_key_max; // stop once the separator key is greater than this key
+        bool m_bounded; // whether the visit stops at m_key_max
+        bool m_valid; // whether the iterator points to an entry
+
+        // Create an iterator pointing to the given entry
+        Iterator(const ImplicitTree* index, uint64_t position, KeyType key_max, bool bounded) noexcept;
+
+    public:
+        bool valid() const noexcept;
+        uint64_t position() const noexcept;
+        KeyType key() const noexcept;
+        void next() noexcept;
+    };
+
+    /**
+     * Initialise the tree with the given node size, capacity and the policy to allocate the keys
+     */
+    ImplicitTree(uint64_t node_size = 65, uint64_t num_entries = 1, const memory::AllocationPolicy& allocation_policy = memory::AllocationPolicy{});
+
+    // The container of the keys cannot be shared
+    ImplicitTree(const ImplicitTree&) = delete;
+    ImplicitTree& operator=(const ImplicitTree&) = delete;
+
+    /**
+     * Destructor
+     */
+    ~ImplicitTree();
+
+    /**
+     * Rebuild the tree to contain `num_entries'
+     */
+    void rebuild(uint64_t num_entries);
+
+    /**
+     * Rebuild the tree and load all the separator keys at once, see StaticIndex#build
+     */
+    void build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads = 1);
+
+    /**
+     * Set the separator key associated to the given entry
+     */
+    void set_separator_key(uint64_t position, KeyType key);
+
+    /**
+     * Add a new entry at the end of the tree, see StaticIndex#append. The slots of the keys do not depend on the
+     * number of entries, the tree is only rebuilt when it grows by one level.
+     */
+    void append(KeyType key);
+
+    /**
+     * Retrieve the number of entries indexed
+     */
+    uint64_t capacity() const noexcept;
+
+    /**
+     * Get the separator key associated to the given entry
+     */
+    KeyType get_separator_key(uint64_t position) const;
+
+    /**
+     * Lookups, with the same semantics of the B-Tree layout
+     */
+    uint64_t find_lt(KeyType key) const noexcept;
+    uint64_t find_lte(KeyType key) const noexcept;
+    uint64_t find_lte_first(KeyType key) const noexcept;
+    uint64_t find_lte_last(KeyType key) const noexcept;
+    void find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+
+    /**
+     * Visit the entries of the tree, with the same semantics of StaticIndex#scan
+     */
+    Iterator scan() const noexcept;
+    Iterator scan(KeyType lo, KeyType hi) const noexcept;
+
+    /**
+     * Retrieve the minimum key stored in the tree
+     */
+    KeyType minimum() const noexcept;
+
+    /**
+     * Retrieve the height of the current static tree
+     */
+    int height() const noexcept;
+
+    /**
+     * Retrieve the block size of each node in the tree
+     */
+    int64_t node_size() const noexcept;
+
+    /**
+     * Retrieve the memory footprint of this index, in bytes
+     */
+    size_t memory_footprint() const;
+
+    /**
+     * Retrieve the policy used to allocate the keys
+     */
+    const memory::AllocationPolicy& allocation_policy() const noexcept;
+
+    /**
+     * Dump the fields of the index
+     */
+    void dump(std::ostream& out, bool* integrity_check = nullptr) const;
+    void dump() const;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template<typename KeyType, typename Layout>
+ImplicitTree<KeyType, Layout>::ImplicitTree(uint64_t node_size, uint64_t num_entries, const memory::AllocationPolicy& allocation_policy) :
+        m_node_size(m_is_veb ? 2 : node_size), m_btree_node_size(node_size), m_height(0), m_capacity(0), m_num_slots(0), m_keys(nullptr), m_key_minimum(std::numeric_limits<KeyType>::max()),
+        m_allocation_policy(allocation_policy) {
+    if(node_size > (uint64_t) std::numeric_limits<uint16_t>::max()){ throw std::invalid_argument("Invalid node size: too big"); }
+    if(m_node_size < 2){ throw std::invalid_argument("Invalid node size: too small"); }
+    rebuild(num_entries);
+}
+
+template<typename KeyType, typename Layout>
+ImplicitTree<KeyType, Layout>::~ImplicitTree(){
+    memory::deallocate(m_keys, m_num_slots * sizeof(KeyType), m_allocation_policy); m_keys = nullptr;
+}
+
+template<typename KeyType, typename Layout>
+int64_t ImplicitTree<KeyType, Layout>::node_size() const noexcept {
+    return m_node_size;
+}
+
+template<typename KeyType, typename Layout>
+int ImplicitTree<KeyType, Layout>::height() const noexcept {
+    return m_height;
+}
+
+template<typename KeyType, typename Layout>
+KeyType ImplicitTree<KeyType, Layout>::minimum() const noexcept {
+    return m_key_minimum;
+}
+
+template<typename KeyType, typename Layout>
+typename ImplicitTree<KeyType, Layout>::Iterator ImplicitTree<KeyType, Layout>::scan() const noexcept {
+    return Iterator{ this, 0, m_key_minimum, /* bounded ? */ false };
+}
+
+template<typename KeyType, typename Layout>
+typename ImplicitTree<KeyType, Layout>::Iterator ImplicitTree<KeyType, Layout>::scan(KeyType lo, KeyType hi) const noexcept {
+    return Iterator{ this, find_lte_first(lo), hi, /* bounded ? */ true };
+}
+
+template<typename KeyType, typename Layout>
+ImplicitTree<KeyType, Layout>::Iterator::Iterator(const ImplicitTree* index, uint64_t position, KeyType key_max, bool bounded) noexcept :
+    m_index(index), m_position(position), m_key(index->get_separator_key(position)), m_key_max(key_max), m_bounded(bounded), m_valid(true) {
+
+}
+
+template<typename KeyType, typename Layout>
+bool ImplicitTree<KeyType, Layout>::Iterator::valid() const noexcept {
+    return m_valid;
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::Iterator::position() const noexcept {
+    assert(valid());
+    return m_position;
+}
+
+template<typename KeyType, typename Layout>
+KeyType ImplicitTree<KeyType, Layout>::Iterator::key() const noexcept {
+    assert(valid());
+    return m_key;
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::Iterator::next() noexcept {
+    assert(valid());
+    m_position++;
+    if(m_position >= m_index->m_capacity){
+        m_valid = false;
+    } else {
+        m_key = m_index->m_keys[m_index->slot(m_position -1)];
+        m_valid = !m_bounded || m_key <= m_key_max;
+    }
+}
+
+template<typename KeyType, typename Layout>
+size_t ImplicitTree<KeyType, Layout>::memory_footprint() const {
+    return m_num_slots * sizeof(KeyType);
+}
+
+template<typename KeyType, typename Layout>
+const memory::AllocationPolicy& ImplicitTree<KeyType, Layout>::allocation_policy() const noexcept {
+    return m_allocation_policy;
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::rebuild(uint64_t N){
+    if(N == 0) throw std::invalid_argument("Invalid number of keys: 0");
+    const uint64_t B = node_size();
+
+    // the smallest perfect tree that can hold the keys of the entries [1, N)
+    int height = 0;
+    uint64_t num_slots = 0; // B^height -1
+    m_level_start[0] = 0;
+    while(num_slots < N -1){
+        if(height >= m_max_height || num_slots > (std::numeric_limits<uint64_t>::max() / sizeof(KeyType) - (B -1)) / B){
+            throw std::invalid_argument("Invalid number of keys/segments: too big");
+        }
+        num_slots = num_slots * B + (B -1);
+        m_level_start[height +1] = m_level_start[height] * B + 1;
+        height++;
+    }
+
+    if(num_slots != m_num_slots){
+        memory::deallocate(m_keys, m_num_slots * sizeof(KeyType), m_allocation_policy); m_keys = nullptr; m_num_slots = 0;
+        if(num_slots > 0){
+            m_keys = reinterpret_cast<KeyType*>( memory::allocate(num_slots * sizeof(KeyType), m_allocation_policy) );
+        }
+        m_num_slots = num_slots;
+    }
+    m_height = height;
+    m_capacity = N;
+
+    // the padding must be greater or equal than any key for the searches to be correct
+    std::fill(m_keys, m_keys + m_num_slots, std::numeric_limits<KeyType>::max());
+
+    if(m_is_veb){ init_veb(0, m_height); }
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::init_veb(int depth, int height){
+    if(height <= 1) return; // base case
+    int top_height = height / 2;
+    int bottom_height = height - top_height;
+    VebLevel& level = m_veb[depth + top_height];
+    level.m_top_depth = depth;
+    level.m_top_sz = (uint64_t(1) << top_height) -1;
+    level.m_bottom_sz = (uint64_t(1) << bottom_height) -1;
+
+    init_veb(depth, top_height);
+    init_veb(depth + top_height, bottom_height);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::veb_position(uint64_t index, int depth) const noexcept {
+    uint64_t position[m_max_height];
+    position[0] = 0;
+    for(int d = 1; d <= depth; d++){
+        const VebLevel& level = m_veb[d];
+        uint64_t ancestor = index >> (depth - d);
+        position[d] = position[level.m_top_depth] + level.m_top_sz + (ancestor & level.m_top_sz) * level.m_bottom_sz;
+    }
+    return position[depth];
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::slot(uint64_t rank) const noexcept {
+    assert(rank < m_num_slots && "Invalid rank");
+    const uint64_t B = node_size();
+
+    // in a perfect tree, the key with rank r sits at the depth h -1 -j, where B^j is the largest power dividing r+1
+    uint64_t x = rank +1;
+    int j = 0;
+    while(x % B == 0){ x /= B; j++; }
+    int depth = m_height -1 -j;
+    uint64_t node_in_level = x / B;
+    uint64_t key_in_node = x % B -1;
+
+    if constexpr (m_is_veb){
+        return veb_position((uint64_t(1) << depth) + node_in_level, depth);
+    } else {
+        return (m_level_start[depth] + node_in_level) * (B -1) + key_in_node;
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads){
+    rebuild(num_entries);
+    m_key_minimum = separators[0];
+
+    auto fill = [this, separators](uint64_t start, uint64_t end){
+        for(uint64_t rank = start; rank < end; rank++){
+            m_keys[slot(rank)] = separators[rank +1];
+        }
+    };
+
+    const uint64_t num_keys = num_entries -1;
+    if(num_threads <= 1){
+        fill(0, num_keys);
+    } else {
+        std::vector<std::future<void>> workers;
+        for(uint64_t worker_id = 0; worker_id < num_threads; worker_id++){
+            uint64_t start = num_keys * worker_id / num_threads;
+            uint64_t end = num_keys * (worker_id +1) / num_threads;
+            if(start == end) continue;
+            workers.push_back(std::async(std::launch::async, fill, start, end));
+        }
+        for(auto& w : workers){ w.get(); }
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::set_separator_key(uint64_t position, KeyType key){
+    assert(position < m_capacity && "Invalid slot");
+    if(position == 0) {
+        m_key_minimum = key;
+    } else {
+        m_keys[slot(position -1)] = key;
+    }
+
+    assert(get_separator_key(position) == key);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::append(KeyType key){
+    const uint64_t N = m_capacity; // the position of the new entry
+    if(key < get_separator_key(N -1)){ throw std::invalid_argument("The separator keys must be appended in sorted order"); }
+
+    if(N -1 < m_num_slots){ // there is still room in the perfect tree
+        m_keys[slot(N -1)] = key;
+        m_capacity = N +1;
+    } else { // one more level
+        std::vector<KeyType> separators;
+        separators.reserve(N +1);
+        for(auto it = scan(); it.valid(); it.next()){ separators.push_back(it.key()); }
+        separators.push_back(key);
+        build(separators.data(), N +1);
+    }
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::capacity() const noexcept {
+    return m_capacity;
+}
+
+template<typename KeyType, typename Layout>
+KeyType ImplicitTree<KeyType, Layout>::get_separator_key(uint64_t position) const {
+    assert(position < m_capacity && "Invalid slot");
+    if(position == 0)
+        return m_key_minimum;
+    else
+        return m_keys[slot(position -1)];
+}
+
+template<typename KeyType, typename Layout>
+typename ImplicitTree<KeyType, Layout>::Cursor ImplicitTree<KeyType, Layout>::cursor_root() const noexcept {
+    Cursor cursor;
+    cursor.m_index = m_is_veb ? 1 : 0;
+    cursor.m_depth = 0;
+    cursor.m_successor = std::numeric_limits<KeyType>::max();
+    if constexpr (m_is_veb){ cursor.m_veb_pos[0] = 0; }
+    return cursor;
+}
+
+template<typename KeyType, typename Layout>
+const KeyType* ImplicitTree<KeyType, Layout>::cursor_node(const Cursor& cursor) const noexcept {
+    if constexpr (m_is_veb){
+        return m_keys + cursor.m_veb_pos[cursor.m_depth];
+    } else {
+        return m_keys + cursor.m_index * (node_size() -1);
+    }
+}
+
+template<typename KeyType, typename Layout>
+template<bool Inclusive>
+void ImplicitTree<KeyType, Layout>::cursor_descend(Cursor& cursor, KeyType key) const noexcept {
+    const KeyType* __restrict node = cursor_node(cursor);
+
+    if constexpr (m_is_veb){
+        KeyType value = node[0];
+        bool right = Inclusive ? (value <= key) : (value < key);
+        if(!right) cursor.m_successor = value;
+        cursor.m_index = 2 * cursor.m_index + right;
+        cursor.m_depth++;
+        if(cursor.m_depth < m_height){
+            const VebLevel& level = m_veb[cursor.m_depth];
+            cursor.m_veb_pos[cursor.m_depth] = cursor.m_veb_pos[level.m_top_depth] + level.m_top_sz + (cursor.m_index & level.m_top_sz) * level.m_bottom_sz;
+        }
+    } else {
+        const uint64_t node_sz = node_size() -1;
+        uint64_t position = (node_sz == 1) ? /* binary tree */ (Inclusive ? node[0] <= key : node[0] < key) : rank<Inclusive>(node, node_sz, key);
+        if(position < node_sz) cursor.m_successor = node[position];
+        cursor.m_index = cursor.m_index * node_size() + 1 + position;
+        cursor.m_depth++;
+    }
+}
+
+template<typename KeyType, typename Layout>
+template<Search mode>
+uint64_t ImplicitTree<KeyType, Layout>::cursor_entry(const Cursor& cursor, KeyType key) const noexcept {
+    if(mode == Search::LT || mode == Search::LTE_LAST){
+        if(key < m_key_minimum) return 0; // easy!
+    } else {
+        if(key <= m_key_minimum) return 0; // easy!
+    }
+
+    // the position reached in the last level, that is the number of keys smaller than (or equal to) the search key
+    uint64_t num_keys = m_capacity -1;
+    uint64_t position = cursor.m_index - (m_is_veb ? (uint64_t(1) << m_height) : m_level_start[m_height]);
+    if(position > num_keys) position = num_keys; // the padding
+
+    if(mode == Search::LTE_FIRST && position < num_keys && cursor.m_successor == key){
+        position = btree_lte_first(position, find<Search::LTE_LAST>(key));
+    }
+
+    return position;
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::btree_lte_first(uint64_t position_lt, uint64_t position_lte_last) const noexcept {
+    if(position_lte_last == position_lt +1) return position_lte_last; // the key is not repeated
+
+    // descend the shape of the B-Tree layout, see StaticIndex#init_layout and StaticIndex#cursor_descend. In each node,
+    // skip the children whose first entry is smaller than the key, plus the next one if its first entry is equal to the key.
+    const uint64_t B = m_btree_node_size;
+    auto subtree_height = [B](uint64_t num_entries){ // the smallest height such that B^height >= num_entries
+        int height = 0;
+        for(uint64_t power = 1; power < num_entries; power *= B) height++;
+        return height;
+    };
+    auto subtree_size = [B](int height){ // B^(height -1)
+        uint64_t result = 1;
+        for(int i = 1; i < height; i++) result *= B;
+        return result;
+    };
+
+    uint64_t offset = 0; // the first entry indexed by the current subtree
+    uint64_t num_entries = m_capacity; // the number of entries indexed by the current subtree, if rightmost
+    int height = subtree_height(num_entries);
+    uint64_t child_sz = subtree_size(height); // the number of entries indexed by each child of the current node
+    bool rightmost = true;
+    while(height > 0){
+        const uint64_t node_sz = rightmost ? (num_entries -1) / child_sz : B -1;
+        uint64_t subtree_id = (position_lt >= offset) ? std::min(node_sz, (position_lt - offset) / child_sz) : 0;
+        if(subtree_id < node_sz && offset + (subtree_id +1) * child_sz <= position_lte_last){ subtree_id++; }
+        offset += subtree_id * child_sz;
+
+        rightmost = rightmost && (subtree_id >= node_sz);
+        if(rightmost){
+            num_entries = (num_entries -1) % child_sz;
+            if(num_entries > 0){ num_entries++; } // with B-1 keys we index B entries
+            height = subtree_height(num_entries);
+            child_sz = subtree_size(height);
+        } else {
+            height--;
+            child_sz /= B;
+        }
+    }
+
+    return offset;
+}
+
+template<typename KeyType, typename Layout>
+template<Search mode>
+uint64_t ImplicitTree<KeyType, Layout>::find(KeyType key) const noexcept {
+    constexpr bool inclusive = (mode == Search::LTE || mode == Search::LTE_LAST);
+
+    Cursor cursor = cursor_root();
+    while(cursor.m_depth < m_height){
+        cursor_descend<inclusive>(cursor, key);
+    }
+
+    return cursor_entry<mode>(cursor, key);
+}
+
+template<typename KeyType, typename Layout>
+template<Search mode>
+void ImplicitTree<KeyType, Layout>::find(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    constexpr bool inclusive = (mode == Search::LTE || mode == Search::LTE_LAST);
+    const uint64_t node_bytes = (node_size() -1) * sizeof(KeyType);
+    Cursor cursors[m_batch_sz];
+
+    for(uint64_t batch_start = 0; batch_start < num_keys; batch_start += m_batch_sz){
+        const uint64_t batch_sz = std::min<uint64_t>(m_batch_sz, num_keys - batch_start);
+        for(uint64_t i = 0; i < batch_sz; i++){ cursors[i] = cursor_root(); }
+
+        // the tree is perfect, all cursors have the same depth
+        for(int depth = 0; depth < m_height; depth++){
+            for(uint64_t i = 0; i < batch_sz; i++){
+                cursor_descend<inclusive>(cursors[i], keys[batch_start + i]);
+
+                if(depth +1 < m_height){ // request the next node
+                    const char* node = reinterpret_cast<const char*>(cursor_node(cursors[i]));
+                    for(uint64_t line = 0; line < node_bytes; line += 64){ __builtin_prefetch(node + line); }
+                }
+            }
+        }
+
+        for(uint64_t i = 0; i < batch_sz; i++){ out[batch_start + i] = cursor_entry<mode>(cursors[i], keys[batch_start + i]); }
+    }
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::find_lt(KeyType key) const noexcept {
+    return find<Search::LT>(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::find_lte(KeyType key) const noexcept {
+    return find<Search::LTE>(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::find_lte_first(KeyType key) const noexcept {
+    return find<Search::LTE_FIRST>(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ImplicitTree<KeyType, Layout>::find_lte_last(KeyType key) const noexcept {
+    return find<Search::LTE_LAST>(key);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    find<Search::LT>(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    find<Search::LTE>(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    find<Search::LTE_FIRST>(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    find<Search::LTE_LAST>(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::dump(std::ostream& out, bool* integrity_check) const {
+    out << "[Index] layout: " << (m_is_veb ? "van Emde Boas" : "Eytzinger") << ", block size: " << node_size() <<
+            ", height: " << height() << ", capacity (number of entries indexed): " << m_capacity << ", minimum: " << minimum() << "\n";
+
+    KeyType previous = m_key_minimum;
+    for(uint64_t position = 1; position < m_capacity; position++){
+        KeyType key = get_separator_key(position);
+        out << "  [" << position << "] slot: " << slot(position -1) << ", key: " << key;
+        if(key < previous){
+            out << " (ERROR: sorted order not respected: " << previous << " > " << key << ")";
+            if(integrity_check) *integrity_check = false;
+        }
+        out << "\n";
+        previous = key;
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ImplicitTree<KeyType, Layout>::dump() const {
+    dump(std::cout);
+}
+
+} // namespace common::details::static_index
+
+namespace common {
+
+/**
+ * Static index with the keys stored in the Eytzinger layout, see index_layout::Eytzinger
+ */
+template<typename KeyType>
+class StaticIndex<KeyType, index_layout::Eytzinger> : public details::static_index::ImplicitTree<KeyType, index_layout::Eytzinger> {
+public:
+    using details::static_index::ImplicitTree<KeyType, index_layout::Eytzinger>::ImplicitTree;
+};
+
+/**
+ * Static index with the keys stored in the van Emde Boas layout, see index_layout::VanEmdeBoas
+ */
+template<typename KeyType>
+class StaticIndex<KeyType, index_layout::VanEmdeBoas> : public details::static_index::ImplicitTree<KeyType, index_layout::VanEmdeBoas> {
+public:
+    using details::static_index::ImplicitTree<KeyType, index_layout::VanEmdeBoas>::ImplicitTree;
+};
+
+} // namespace common
+
+#endif //COMMON_STATIC_INDEX_IMPLICIT_HPP
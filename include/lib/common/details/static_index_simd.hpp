@@ -0,0 +1,245 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_STATIC_INDEX_SIMD_HPP
+#define COMMON_STATIC_INDEX_SIMD_HPP
+
+#include <atomic>
+#include <cinttypes>
+#include <type_traits>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define COMMON_STATIC_INDEX_HAVE_X86_SIMD
+#endif
+
+namespace common::details::static_index {
+
+    /**
+     * The instruction sets that can be used to search inside a node
+     */
+    enum class SimdLevel : int { SCALAR = 0, SSE42 = 1, AVX2 = 2, AVX512 = 3 };
+
+    // Retrieve the best instruction set supported by the current CPU
+    inline SimdLevel detect_simd_level() noexcept {
+#if defined(COMMON_STATIC_INDEX_HAVE_X86_SIMD)
+        __builtin_cpu_init(); // we may be invoked before main()
+        if(__builtin_cpu_supports("avx512f")){ return SimdLevel::AVX512; }
+        if(__builtin_cpu_supports("avx2")){ return SimdLevel::AVX2; }
+        if(__builtin_cpu_supports("sse4.2")){ return SimdLevel::SSE42; }
+#endif
+        return SimdLevel::SCALAR;
+    }
+
+    // The instruction set actually in use, resolved once at start up
+    inline std::atomic<SimdLevel> g_simd_level { detect_simd_level() };
+
+    /**
+     * Retrieve the instruction set used to search the nodes of the static indexes
+     */
+    inline SimdLevel simd_level() noexcept {
+        return g_simd_level.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Change the instruction set used to search the nodes. The level is capped to the one supported
+     * by the current CPU. Only meant for testing and benchmarking, it returns the level effectively set.
+     */
+    inline SimdLevel set_simd_level(SimdLevel level) noexcept {
+        SimdLevel max_level = detect_simd_level();
+        if(static_cast<int>(level) > static_cast<int>(max_level)) level = max_level;
+        g_simd_level.store(level, std::memory_order_relaxed);
+        return level;
+    }
+
+    // Whether there is a vectorised kernel for the given key type
+    template<typename T>
+    constexpr bool is_simd_key = (std::is_integral_v<T> && (sizeof(T) == 4 || sizeof(T) == 8) && !std::is_same_v<T, bool>) ||
+            std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+    // Scalar implementation of #rank
+    template<bool Inclusive, typename T>
+    inline uint64_t rank_scalar(const T* __restrict node, uint64_t node_sz, T key) noexcept {
+        uint64_t position = 0;
+        if constexpr (Inclusive){
+            while(position < node_sz && node[position] <= key) position++;
+        } else {
+            while(position < node_sz && node[position] < key) position++;
+        }
+        return position;
+    }
+
+#if defined(COMMON_STATIC_INDEX_HAVE_X86_SIMD)
+    // SSE4.2, 128 bit registers
+    template<bool Inclusive, typename T>
+    __attribute__((target("sse4.2,popcnt")))
+    uint64_t rank_sse42(const T* __restrict node, uint64_t node_sz, T key) noexcept {
+        constexpr uint64_t width = 16 / sizeof(T);
+        uint64_t i = 0;
+        uint64_t count = 0;
+
+        if constexpr (std::is_same_v<T, double>){
+            const __m128d k = _mm_set1_pd(key);
+            for( ; i + width <= node_sz; i += width){
+                __m128d v = _mm_loadu_pd(node + i);
+                __m128d cmp = Inclusive ? _mm_cmple_pd(v, k) : _mm_cmplt_pd(v, k);
+                count += __builtin_popcount(_mm_movemask_pd(cmp));
+            }
+        } else if constexpr (std::is_same_v<T, float>){
+            const __m128 k = _mm_set1_ps(key);
+            for( ; i + width <= node_sz; i += width){
+                __m128 v = _mm_loadu_ps(node + i);
+                __m128 cmp = Inclusive ? _mm_cmple_ps(v, k) : _mm_cmplt_ps(v, k);
+                count += __builtin_popcount(_mm_movemask_ps(cmp));
+            }
+        } else { // integers
+            // unsigned comparisons are performed as signed comparisons after flipping the sign bit
+            constexpr bool flip = std::is_unsigned_v<T>;
+            const __m128i sign = (sizeof(T) == 8) ? _mm_set1_epi64x(INT64_MIN) : _mm_set1_epi32(INT32_MIN);
+            __m128i k = (sizeof(T) == 8) ? _mm_set1_epi64x(static_cast<int64_t>(key)) : _mm_set1_epi32(static_cast<int32_t>(key));
+            if(flip) k = _mm_xor_si128(k, sign);
+            for( ; i + width <= node_sz; i += width){
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(node + i));
+                if(flip) v = _mm_xor_si128(v, sign);
+                // lt: k > v, lte: not (v > k)
+                uint64_t matches;
+                if(sizeof(T) == 8){
+                    __m128i cmp = Inclusive ? _mm_cmpgt_epi64(v, k) : _mm_cmpgt_epi64(k, v);
+                    matches = __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(cmp)));
+                } else {
+                    __m128i cmp = Inclusive ? _mm_cmpgt_epi32(v, k) : _mm_cmpgt_epi32(k, v);
+                    matches = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(cmp)));
+                }
+                count += Inclusive ? width - matches : matches;
+            }
+        }
+
+        return count + rank_scalar<Inclusive>(node + i, node_sz - i, key);
+    }
+
+    // AVX2, 256 bit registers
+    template<bool Inclusive, typename T>
+    __attribute__((target("avx2,popcnt")))
+    uint64_t rank_avx2(const T* __restrict node, uint64_t node_sz, T key) noexcept {
+        constexpr uint64_t width = 32 / sizeof(T);
+        uint64_t i = 0;
+        uint64_t count = 0;
+
+        if constexpr (std::is_same_v<T, double>){
+            const __m256d k = _mm256_set1_pd(key);
+            for( ; i + width <= node_sz; i += width){
+                __m256d v = _mm256_loadu_pd(node + i);
+                __m256d cmp = Inclusive ? _mm256_cmp_pd(v, k, _CMP_LE_OQ) : _mm256_cmp_pd(v, k, _CMP_LT_OQ);
+                count += __builtin_popcount(_mm256_movemask_pd(cmp));
+            }
+        } else if constexpr (std::is_same_v<T, float>){
+            const __m256 k = _mm256_set1_ps(key);
+            for( ; i + width <= node_sz; i += width){
+                __m256 v = _mm256_loadu_ps(node + i);
+                __m256 cmp = Inclusive ? _mm256_cmp_ps(v, k, _CMP_LE_OQ) : _mm256_cmp_ps(v, k, _CMP_LT_OQ);
+                count += __builtin_popcount(_mm256_movemask_ps(cmp));
+            }
+        } else { // integers
+            constexpr bool flip = std::is_unsigned_v<T>;
+            const __m256i sign = (sizeof(T) == 8) ? _mm256_set1_epi64x(INT64_MIN) : _mm256_set1_epi32(INT32_MIN);
+            __m256i k = (sizeof(T) == 8) ? _mm256_set1_epi64x(static_cast<int64_t>(key)) : _mm256_set1_epi32(static_cast<int32_t>(key));
+            if(flip) k = _mm256_xor_si256(k, sign);
+            for( ; i + width <= node_sz; i += width){
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(node + i));
+                if(flip) v = _mm256_xor_si256(v, sign);
+                uint64_t matches;
+                if(sizeof(T) == 8){
+                    __m256i cmp = Inclusive ? _mm256_cmpgt_epi64(v, k) : _mm256_cmpgt_epi64(k, v);
+                    matches = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(cmp)));
+                } else {
+                    __m256i cmp = Inclusive ? _mm256_cmpgt_epi32(v, k) : _mm256_cmpgt_epi32(k, v);
+                    matches = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(cmp)));
+                }
+                count += Inclusive ? width - matches : matches;
+            }
+        }
+
+        return count + rank_scalar<Inclusive>(node + i, node_sz - i, key);
+    }
+
+    // AVX-512, the tail of the node is handled with a masked comparison
+    template<bool Inclusive, typename T>
+    __attribute__((target("avx512f,popcnt")))
+    uint64_t rank_avx512(const T* __restrict node, uint64_t node_sz, T key) noexcept {
+        constexpr uint64_t width = 64 / sizeof(T);
+        constexpr int op = Inclusive ? _MM_CMPINT_LE : _MM_CMPINT_LT;
+        uint64_t count = 0;
+
+        for(uint64_t i = 0; i < node_sz; i += width){
+            uint64_t remaining = node_sz - i;
+            // lanes beyond the end of the node are masked out and not even loaded
+            uint32_t mask = (remaining >= width) ? static_cast<uint32_t>((1ull << width) -1) : static_cast<uint32_t>((1ull << remaining) -1);
+            uint32_t matches;
+
+            if constexpr (std::is_same_v<T, double>){
+                __m512d v = _mm512_maskz_loadu_pd(mask, node + i);
+                matches = _mm512_mask_cmp_pd_mask(mask, v, _mm512_set1_pd(key), Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            } else if constexpr (std::is_same_v<T, float>){
+                __m512 v = _mm512_maskz_loadu_ps(mask, node + i);
+                matches = _mm512_mask_cmp_ps_mask(mask, v, _mm512_set1_ps(key), Inclusive ? _CMP_LE_OQ : _CMP_LT_OQ);
+            } else if constexpr (sizeof(T) == 8){
+                __m512i v = _mm512_maskz_loadu_epi64(mask, node + i);
+                __m512i k = _mm512_set1_epi64(static_cast<int64_t>(key));
+                if constexpr (std::is_unsigned_v<T>){
+                    matches = _mm512_mask_cmp_epu64_mask(mask, v, k, op);
+                } else {
+                    matches = _mm512_mask_cmp_epi64_mask(mask, v, k, op);
+                }
+            } else { // sizeof(T) == 4
+                __m512i v = _mm512_maskz_loadu_epi32(mask, node + i);
+                __m512i k = _mm512_set1_epi32(static_cast<int32_t>(key));
+                if constexpr (std::is_unsigned_v<T>){
+                    matches = _mm512_mask_cmp_epu32_mask(mask, v, k, op);
+                } else {
+                    matches = _mm512_mask_cmp_epi32_mask(mask, v, k, op);
+                }
+            }
+
+            count += __builtin_popcount(matches);
+        }
+
+        return count;
+    }
+#endif
+
+    /**
+     * Count the number of keys in the sorted node that are smaller than (or equal to, if Inclusive) the given key,
+     * that is the position of the child to descend. The kernel is picked at runtime according to #simd_level().
+     */
+    template<bool Inclusive, typename T>
+    inline uint64_t rank(const T* __restrict node, uint64_t node_sz, T key) noexcept {
+#if defined(COMMON_STATIC_INDEX_HAVE_X86_SIMD)
+        if constexpr (is_simd_key<T>){
+            switch(simd_level()){
+            case SimdLevel::AVX512: return rank_avx512<Inclusive>(node, node_sz, key);
+            case SimdLevel::AVX2: return rank_avx2<Inclusive>(node, node_sz, key);
+            case SimdLevel::SSE42: return rank_sse42<Inclusive>(node, node_sz, key);
+            default: break; // scalar
+            }
+        }
+#endif
+        return rank_scalar<Inclusive>(node, node_sz, key);
+    }
+
+} // namespace
+
+#endif //COMMON_STATIC_INDEX_SIMD_HPP
@@ -0,0 +1,54 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef COMMON_EXTERNAL_SORT_HPP
+#define COMMON_EXTERNAL_SORT_HPP
+
+#include <functional> // std::less
+#include <string>
+
+#include "details/external_sort_impl.hpp"
+#include "quantity.hpp"
+
+namespace common {
+
+    /**
+     * Sort a file larger than the available memory. The file is an array of elements of type T, stored as raw bytes;
+     * T must be trivially copyable.
+     *
+     * The input is read in runs that fit into the memory budget. Each run is sorted in parallel with common::sort and
+     * spilled into a temporary file. The runs are then merged into the output file with a k-way merge, reading each run
+     * with asynchronous read-ahead and writing the output with asynchronous write-behind. The temporary files are
+     * anonymous, they are removed automatically when the sort completes or fails.
+     *
+     * @param path_input the file to sort
+     * @param path_output where to store the sorted elements. It can be the same path of the input.
+     * @param memory_budget the amount of memory to use for the buffers, e.g. ComputerQuantity("16G", true). Each run takes half of the budget,
+     *        as the in-memory sort requires an auxiliary buffer. The budget can be exceeded when the number of runs
+     *        is so high that the buffers for the merge would be smaller than 64 KB.
+     * @param fn_less a comparator function that returns true if the a < b.
+     * @param temporary_directory the directory where to spill the sorted runs. If empty, the directory given by the
+     *        environment variable TMPDIR, or /tmp otherwise.
+     */
+    template<typename T, typename FunctionLess = std::less<T>>
+    void external_sort(const std::string& path_input, const std::string& path_output, const ComputerQuantity& memory_budget,
+            const FunctionLess& fn_less = FunctionLess{}, const std::string& temporary_directory = ""){
+        details::external_sort::implementation<T>(path_input, path_output, memory_budget.magnitude(), fn_less, temporary_directory);
+    }
+
+} // namespace
+
+#endif //COMMON_EXTERNAL_SORT_HPP
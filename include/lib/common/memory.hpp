@@ -0,0 +1,80 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_MEMORY_HPP
+#define COMMON_MEMORY_HPP
+
+#include <cinttypes>
+#include <ostream>
+
+namespace common::memory {
+
+/**
+ * The pages backing an allocation
+ */
+enum class PageSize {
+    DEFAULT, // regular allocation through the C library, 64-byte aligned
+    TRANSPARENT, // anonymous mapping, advising the kernel to use transparent huge pages (madvise)
+    HUGE_2MB, // explicit huge pages of 2 MB (MAP_HUGETLB), falling back to transparent huge pages if none is reserved
+    HUGE_1GB, // explicit huge pages of 1 GB (MAP_HUGETLB), falling back to transparent huge pages if none is reserved
+};
+
+/**
+ * Where the pages of an allocation are placed among the NUMA nodes
+ */
+enum class NumaPolicy {
+    DEFAULT, // the policy of the calling thread, usually the node where the page is first touched
+    INTERLEAVE, // round robin among all NUMA nodes
+    BIND, // on the node given by AllocationPolicy::m_numa_node
+};
+
+/**
+ * How to allocate a (large) chunk of memory
+ */
+struct AllocationPolicy {
+    PageSize m_page_size = PageSize::DEFAULT;
+    NumaPolicy m_numa_policy = NumaPolicy::DEFAULT;
+    int m_numa_node = -1; // only for NumaPolicy::BIND
+};
+
+/**
+ * Allocate a chunk of memory of the given size, aligned at least to 64 bytes, according to the given policy.
+ * A NUMA policy is ignored when the system does not support NUMA. The returned memory is not initialised.
+ * Throw std::bad_alloc if the memory cannot be allocated.
+ */
+void* allocate(uint64_t size, const AllocationPolicy& policy = AllocationPolicy{});
+
+/**
+ * Release a chunk of memory obtained with #allocate. The size and the policy must be the same given to #allocate.
+ */
+void deallocate(void* ptr, uint64_t size, const AllocationPolicy& policy = AllocationPolicy{}) noexcept;
+
+/**
+ * Retrieve the granularity of the pages for the given policy, in bytes
+ */
+uint64_t page_size(PageSize page_size);
+
+/**
+ * Print to the output stream the given policy, for debugging purposes
+ */
+std::ostream& operator<<(std::ostream& out, const PageSize& page_size);
+std::ostream& operator<<(std::ostream& out, const NumaPolicy& numa_policy);
+std::ostream& operator<<(std::ostream& out, const AllocationPolicy& policy);
+
+} // namespace common::memory
+
+#endif //COMMON_MEMORY_HPP
@@ -0,0 +1,260 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_REPLICATED_STATIC_INDEX_HPP
+#define COMMON_REPLICATED_STATIC_INDEX_HPP
+
+#include <cinttypes>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "memory.hpp"
+#include "static_index.hpp"
+#include "system.hpp"
+
+namespace common {
+
+/**
+ * A StaticIndex with one copy of the keys in each NUMA node. The lookups are served by the replica
+ * local to the NUMA node of the calling thread, as reported by concurrency::get_current_numa_node().
+ * When NUMA is not available, there is a single replica.
+ *
+ * The updates (#rebuild, #build, #set_separator_key, #append) are applied to all replicas. As for StaticIndex,
+ * this class is not thread-safe w.r.t. the updates.
+ */
+template<typename KeyType, typename Layout = index_layout::BTree<>>
+class ReplicatedStaticIndex {
+public:
+    using Index = StaticIndex<KeyType, Layout>;
+
+private:
+    std::vector<std::unique_ptr<Index>> m_replicas; // one replica per NUMA node
+
+public:
+    /**
+     * Create the replicas with the given node size and capacity. The keys of each replica are bound to its
+     * NUMA node and allocated with the given page size.
+     */
+    ReplicatedStaticIndex(uint64_t node_size = details::static_index::default_node_size<Layout>::value, uint64_t num_entries = 1, memory::PageSize page_size = memory::PageSize::DEFAULT);
+
+    /**
+     * Change the capacity of all replicas, as in StaticIndex::rebuild
+     */
+    void rebuild(uint64_t num_entries);
+
+    /**
+     * Load the sorted separators into all replicas, as in StaticIndex::build. The replicas are built concurrently,
+     * each one with the given number of threads.
+     */
+    void build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads = 1);
+
+    /**
+     * Set the separator key in all replicas
+     */
+    void set_separator_key(uint64_t position, KeyType key);
+
+    /**
+     * Add a new entry at the end of all replicas, as in StaticIndex::append
+     */
+    void append(KeyType key);
+
+    /**
+     * Retrieve the separator key associated to the given position
+     */
+    KeyType get_separator_key(uint64_t position) const;
+
+    /**
+     * Retrieve the number of entries indexed, the same in all replicas
+     */
+    uint64_t capacity() const noexcept;
+
+    /**
+     * Retrieve the replica in the NUMA node of the calling thread. Threads pinned to a NUMA node can cache the
+     * result, to avoid querying the current node for each lookup.
+     */
+    const Index& local() const noexcept;
+
+    /**
+     * Retrieve the replica in the given NUMA node
+     */
+    const Index& replica(int numa_node) const;
+
+    /**
+     * Retrieve the number of replicas
+     */
+    uint64_t num_replicas() const noexcept;
+
+    /**
+     * Same semantics of the lookups in StaticIndex, served by the local replica
+     */
+    uint64_t find_lt(KeyType key) const noexcept;
+    uint64_t find_lte(KeyType key) const noexcept;
+    uint64_t find_lte_first(KeyType key) const noexcept;
+    uint64_t find_lte_last(KeyType key) const noexcept;
+    void find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+
+    /**
+     * Retrieve the minimum key stored in the index
+     */
+    KeyType minimum() const noexcept;
+
+    /**
+     * Retrieve the memory footprint of all replicas, in bytes
+     */
+    size_t memory_footprint() const;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template<typename KeyType, typename Layout>
+ReplicatedStaticIndex<KeyType, Layout>::ReplicatedStaticIndex(uint64_t node_size, uint64_t num_entries, memory::PageSize page_size) {
+    memory::AllocationPolicy policy;
+    policy.m_page_size = page_size;
+
+    if(!concurrency::has_numa()){
+        m_replicas.emplace_back(new Index(node_size, num_entries, policy));
+    } else {
+        int max_node = concurrency::get_numa_max_node();
+        policy.m_numa_policy = memory::NumaPolicy::BIND;
+        for(int node = 0; node <= max_node; node++){
+            policy.m_numa_node = node;
+            m_replicas.emplace_back(new Index(node_size, num_entries, policy));
+        }
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::rebuild(uint64_t num_entries){
+    for(auto& replica : m_replicas){ replica->rebuild(num_entries); }
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads){
+    if(m_replicas.size() == 1){
+        m_replicas[0]->build(separators, num_entries, num_threads);
+    } else {
+        std::vector<std::future<void>> tasks;
+        for(auto& replica : m_replicas){
+            Index* index = replica.get();
+            tasks.push_back( std::async(std::launch::async, [=](){ index->build(separators, num_entries, num_threads); }) );
+        }
+        for(auto& t: tasks) t.get();
+    }
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::set_separator_key(uint64_t position, KeyType key){
+    for(auto& replica : m_replicas){ replica->set_separator_key(position, key); }
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::append(KeyType key){
+    for(auto& replica : m_replicas){ replica->append(key); }
+}
+
+template<typename KeyType, typename Layout>
+KeyType ReplicatedStaticIndex<KeyType, Layout>::get_separator_key(uint64_t position) const {
+    return local().get_separator_key(position);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::capacity() const noexcept {
+    return m_replicas[0]->capacity();
+}
+
+template<typename KeyType, typename Layout>
+const typename ReplicatedStaticIndex<KeyType, Layout>::Index& ReplicatedStaticIndex<KeyType, Layout>::local() const noexcept {
+    int numa_node = (m_replicas.size() > 1) ? concurrency::get_current_numa_node() : 0;
+    if(numa_node < 0 || numa_node >= static_cast<int>(m_replicas.size())) numa_node = 0;
+    return *(m_replicas[numa_node]);
+}
+
+template<typename KeyType, typename Layout>
+const typename ReplicatedStaticIndex<KeyType, Layout>::Index& ReplicatedStaticIndex<KeyType, Layout>::replica(int numa_node) const {
+    if(numa_node < 0 || numa_node >= static_cast<int>(m_replicas.size())) throw std::invalid_argument("Invalid NUMA node");
+    return *(m_replicas[numa_node]);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::num_replicas() const noexcept {
+    return m_replicas.size();
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::find_lt(KeyType key) const noexcept {
+    return local().find_lt(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::find_lte(KeyType key) const noexcept {
+    return local().find_lte(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::find_lte_first(KeyType key) const noexcept {
+    return local().find_lte_first(key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t ReplicatedStaticIndex<KeyType, Layout>::find_lte_last(KeyType key) const noexcept {
+    return local().find_lte_last(key);
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    local().find_lt(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    local().find_lte(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    local().find_lte_first(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+void ReplicatedStaticIndex<KeyType, Layout>::find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    local().find_lte_last(keys, num_keys, out);
+}
+
+template<typename KeyType, typename Layout>
+KeyType ReplicatedStaticIndex<KeyType, Layout>::minimum() const noexcept {
+    return local().minimum();
+}
+
+template<typename KeyType, typename Layout>
+size_t ReplicatedStaticIndex<KeyType, Layout>::memory_footprint() const {
+    size_t result = 0;
+    for(auto& replica : m_replicas){ result += replica->memory_footprint(); }
+    return result;
+}
+
+} // namespace common
+
+#endif //COMMON_REPLICATED_STATIC_INDEX_HPP
@@ -18,15 +18,26 @@
 #ifndef COMMON_SAMPLING_HPP
 #define COMMON_SAMPLING_HPP
 
+#include <algorithm>
 #include <cinttypes>
+#include <cmath>
+#include <limits>
 #include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "details/sampling_impl.hpp"
 
 namespace common {
 
 /**
- * Retrieve a random sample of the input following a uniform distribution
+ * Retrieve a random sample of the input following a uniform distribution. The samples are copied in the output in the
+ * same order of their position in the input.
+ *
+ * The input is split into chunks of a fixed size, sampled in parallel. The number of samples of each chunk is drawn from
+ * the multivariate hypergeometric distribution, then each chunk is sampled with Vitter's method and its own random
+ * generator. The result only depends on the seed, not on the number of threads.
  *
  * @param input the array to sample
  * @param input_sz the size of the array `input'
@@ -40,6 +51,380 @@ void random_sample(const T* input, uint64_t input_sz, T* output, uint64_t& num_s
     details::sampling::implementation(input, input_sz, output, num_samples, seed); // details/sampling_impl.hpp
 }
 
+/**
+ * Retrieve a weighted random sample of the input, without replacement. At each step, the probability to select an
+ * element is proportional to its weight, among the elements not selected yet. The samples are copied in the output in
+ * the same order of their position in the input.
+ *
+ * It implements the method of Efraimidis and Spirakis: each element is assigned the random key E/w, where w is its
+ * weight and E follows an exponential distribution, and the elements with the k smallest keys are selected. The keys
+ * are computed and the top-k selected in parallel, for chunks of a fixed size, thus the result only depends on the seed.
+ *
+ * @param input the array to sample
+ * @param weights the weight of each element of the input, finite and not negative. Elements with weight 0 are never selected.
+ * @param input_sz the size of the arrays `input' and `weights'
+ * @param output the output array where the samples will be copied. It must be preallocated by the caller with a
+ *        capacity of at least of `num_samples'
+ * @param num_samples the total number of samples to retrieve. On return, it is capped to the number of elements with a
+ *        positive weight.
+ * @param seed the seed for the random generator
+ */
+template<typename T, typename W>
+void weighted_random_sample(const T* input, const W* weights, uint64_t input_sz, T* output, uint64_t& num_samples, uint64_t seed = std::random_device{}()){
+    details::sampling::weighted_implementation(input, weights, input_sz, output, num_samples, seed); // details/sampling_impl.hpp
+}
+
+/**
+ * A table to draw the positions of a set of weights, with replacement, with a probability proportional to their weight,
+ * e.g. to select the vertices of a graph biased by their degree. Each draw takes O(1) time.
+ *
+ * The weights are split into blocks of a fixed size. The alias table of each block is built in parallel with Vose's
+ * method, and a further alias table selects the block, proportionally to its total weight. A draw first selects the
+ * block, then the position inside the block. The construction takes O(n) time.
+ */
+class AliasTable {
+    uint64_t m_size; // the number of weights
+    std::vector<details::sampling::AliasBucket> m_blocks; // the alias table to select a block
+    std::vector<details::sampling::AliasBucket> m_buckets; // the alias tables of all blocks, one after the other
+
+    // Draw the position of a weight, given two uniform numbers in [0, 1)
+    uint64_t draw(double u1, double u2) const;
+
+    // Draw `num_samples' positions in parallel, for each invoke fn(i, position)
+    template<typename Function>
+    void sample(uint64_t num_samples, uint64_t seed, const Function& fn) const;
+
+public:
+    /**
+     * Build the table for the given weights. The weights must be finite and not negative, and at least one must be
+     * positive. Weights equal to 0 are never drawn.
+     */
+    template<typename W>
+    AliasTable(const W* weights, uint64_t num_weights);
+
+    /**
+     * Draw the position of a weight with the given random generator, e.g. std::mt19937_64
+     */
+    template<typename Generator>
+    uint64_t operator()(Generator& generator) const;
+
+    /**
+     * Draw in parallel `num_samples' positions into the output array. The result only depends on the seed.
+     */
+    void sample(uint64_t* output, uint64_t num_samples, uint64_t seed = std::random_device{}()) const;
+
+    /**
+     * Draw in parallel `num_samples' elements of the input into the output array. The input must have one element
+     * for each weight.
+     */
+    template<typename T>
+    void sample(const T* input, T* output, uint64_t num_samples, uint64_t seed = std::random_device{}()) const;
+
+    /**
+     * Retrieve the number of weights in the table
+     */
+    uint64_t size() const noexcept;
+};
+
+/**
+ * Retrieve a weighted random sample of the input, with replacement: each sample is selected independently, with a
+ * probability proportional to its weight. It builds an AliasTable of the weights, use it directly to draw multiple
+ * times from the same weights.
+ *
+ * @param input the array to sample
+ * @param weights the weight of each element of the input, finite and not negative, with at least one positive.
+ * @param input_sz the size of the arrays `input' and `weights'
+ * @param output the output array where the samples will be copied, with a capacity of at least of `num_samples'
+ * @param num_samples the total number of samples to retrieve
+ * @param seed the seed for the random generator
+ */
+template<typename T, typename W>
+void weighted_random_sample_with_replacement(const T* input, const W* weights, uint64_t input_sz, T* output, uint64_t num_samples, uint64_t seed = std::random_device{}()){
+    AliasTable table { weights, input_sz };
+    table.sample(input, output, num_samples, seed);
+}
+
+/**
+ * A uniform random sample of fixed size over a stream of unknown length, e.g. the lines of a log or the edges read from
+ * disk. The sampler keeps a reservoir of at most `capacity' elements: at any time, it is a uniform sample without
+ * replacement of all the elements offered so far.
+ *
+ * It implements Li's Algorithm L: rather than drawing a random number for each element offered, it computes how many
+ * elements to skip before the next one that enters the reservoir. The random generator is invoked O(k log(N/k)) times
+ * for a stream of N elements and a reservoir of k elements, and the skipped elements of a batch are not even read.
+ *
+ * Samplers fed by different threads can be combined with #merge, for a sample of the union of their streams.
+ *
+ * The data structure is not thread safe.
+ */
+template<typename T>
+class ReservoirSampler {
+    const uint64_t m_capacity; // the max number of elements in the reservoir, k
+    std::vector<T> m_reservoir; // the current sample
+    uint64_t m_num_seen; // the number of elements offered so far
+    uint64_t m_next; // the position in the stream of the next element to insert in the reservoir, once it is full, otherwise max()
+    double m_threshold; // Algorithm L, the variable W: the largest key among the elements in the reservoir
+    details::sampling::RandomGenerator m_random; // the random generator
+
+    // A random number in (0, 1], to be used with log()
+    double random();
+
+    // Compute the position of the next element to insert in the reservoir
+    void skip();
+
+    // Insert the given element in the reservoir, once full, replacing a random element
+    void replace(const T& item);
+
+    // Reset the threshold for a reservoir being a uniform sample of m_num_seen elements, e.g. after a merge
+    void reset_threshold();
+
+public:
+    /**
+     * Create a sampler with a reservoir of the given capacity
+     */
+    ReservoirSampler(uint64_t capacity, uint64_t seed = std::random_device{}());
+
+    /**
+     * Offer a single element of the stream
+     */
+    void offer(const T& item);
+
+    /**
+     * Offer a batch of elements of the stream
+     */
+    void offer(const T* items, uint64_t num_items);
+
+    /**
+     * Combine with the sample of another stream. Afterwards, this reservoir is a uniform sample of the union of the two
+     * streams, and further elements can be still offered. The other sampler is not altered. The two samplers must
+     * have the same capacity.
+     */
+    void merge(const ReservoirSampler& other);
+
+    /**
+     * Retrieve the current sample. The order of the elements is arbitrary.
+     */
+    const std::vector<T>& samples() const noexcept;
+
+    /**
+     * Retrieve the number of elements in the reservoir, that is min(capacity, num_seen)
+     */
+    uint64_t size() const noexcept;
+
+    /**
+     * Retrieve the max number of elements in the reservoir
+     */
+    uint64_t capacity() const noexcept;
+
+    /**
+     * Retrieve the number of elements offered so far, including those of the merged samplers
+     */
+    uint64_t num_seen() const noexcept;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template<typename T>
+ReservoirSampler<T>::ReservoirSampler(uint64_t capacity, uint64_t seed) : m_capacity(capacity), m_num_seen(0), m_next(std::numeric_limits<uint64_t>::max()), m_threshold(0), m_random(seed) {
+    if(capacity == 0) throw std::invalid_argument("Invalid capacity: 0");
+    m_reservoir.reserve(std::min<uint64_t>(capacity, 1ull << 20));
+}
+
+template<typename T>
+double ReservoirSampler<T>::random(){
+    return 1.0 - m_random();
+}
+
+template<typename T>
+void ReservoirSampler<T>::skip(){
+    // the number of elements with a key greater than the threshold follows a geometric distribution
+    double gap = std::floor(std::log(random()) / std::log1p(-m_threshold));
+    if(!(gap < static_cast<double>(std::numeric_limits<uint64_t>::max() - m_next -1))){ // also NaN
+        m_next = std::numeric_limits<uint64_t>::max(); // never
+    } else {
+        m_next += static_cast<uint64_t>(gap) +1;
+    }
+}
+
+template<typename T>
+void ReservoirSampler<T>::replace(const T& item){
+    uint64_t position = std::min<uint64_t>(m_capacity -1, static_cast<uint64_t>(m_random() * m_capacity));
+    m_reservoir[position] = item;
+    m_threshold *= std::exp(std::log(random()) / m_capacity); // the max of k uniform keys in [0, W]
+    skip();
+}
+
+template<typename T>
+void ReservoirSampler<T>::reset_threshold(){
+    if(m_num_seen < m_capacity){ // the reservoir is not full yet, the next elements are appended
+        m_next = std::numeric_limits<uint64_t>::max();
+        return;
+    }
+
+    // the k-th smallest key among N uniform keys follows the distribution Beta(k, N - k + 1)
+    std::gamma_distribution<double> gamma_k (m_capacity);
+    std::gamma_distribution<double> gamma_n (m_num_seen - m_capacity + 1);
+    double x = gamma_k(m_random.m_generator);
+    double y = gamma_n(m_random.m_generator);
+    m_threshold = x / (x + y);
+    m_next = m_num_seen -1; // position of the last element seen
+    skip();
+}
+
+template<typename T>
+void ReservoirSampler<T>::offer(const T& item){
+    offer(&item, 1);
+}
+
+template<typename T>
+void ReservoirSampler<T>::offer(const T* items, uint64_t num_items){
+    // fill the reservoir
+    uint64_t i = 0;
+    while(i < num_items && m_num_seen < m_capacity){
+        m_reservoir.push_back(items[i]);
+        i++;
+        m_num_seen++;
+        if(m_num_seen == m_capacity){ // first threshold, the max of k uniform keys
+            m_threshold = std::exp(std::log(random()) / m_capacity);
+            m_next = m_num_seen -1;
+            skip();
+        }
+    }
+
+    if(m_num_seen < m_capacity) return; // all items appended, the reservoir is not full yet
+
+    // jump to the elements entering the reservoir
+    const uint64_t end = m_num_seen + (num_items - i);
+    while(m_next < end){
+        replace(items[i + (m_next - m_num_seen)]);
+    }
+    m_num_seen = end;
+}
+
+template<typename T>
+void ReservoirSampler<T>::merge(const ReservoirSampler& other){
+    if(other.m_capacity != m_capacity) throw std::invalid_argument("The two samplers have a different capacity");
+    if(other.m_num_seen == 0) return;
+
+    // how many elements of the union are drawn from this reservoir follows the hypergeometric distribution
+    const uint64_t num_seen = m_num_seen + other.m_num_seen;
+    const uint64_t num_samples = std::min(m_capacity, num_seen);
+    const uint64_t num_mine = details::sampling::hypergeometric(m_random, num_samples, m_num_seen, num_seen);
+    const uint64_t num_other = num_samples - num_mine;
+
+    // a random subset of a uniform sample is a uniform sample, select it with a partial Fisher-Yates shuffle
+    auto select = [this](std::vector<T>& elements, uint64_t count){
+        for(uint64_t i = 0; i < count; i++){
+            uint64_t j = i + std::min<uint64_t>(elements.size() - i -1, static_cast<uint64_t>(m_random() * (elements.size() - i)));
+            std::swap(elements[i], elements[j]);
+        }
+        elements.resize(count);
+    };
+    select(m_reservoir, num_mine);
+    std::vector<T> reservoir_other = other.m_reservoir;
+    select(reservoir_other, num_other);
+    m_reservoir.insert(m_reservoir.end(), reservoir_other.begin(), reservoir_other.end());
+
+    m_num_seen = num_seen;
+    reset_threshold();
+}
+
+template<typename T>
+const std::vector<T>& ReservoirSampler<T>::samples() const noexcept {
+    return m_reservoir;
+}
+
+template<typename T>
+uint64_t ReservoirSampler<T>::size() const noexcept {
+    return m_reservoir.size();
+}
+
+template<typename T>
+uint64_t ReservoirSampler<T>::capacity() const noexcept {
+    return m_capacity;
+}
+
+template<typename T>
+uint64_t ReservoirSampler<T>::num_seen() const noexcept {
+    return m_num_seen;
+}
+
+template<typename W>
+AliasTable::AliasTable(const W* weights, uint64_t num_weights) : m_size(num_weights) {
+    using namespace details::sampling;
+    const uint64_t num_blocks = (num_weights + alias_block_sz -1) / alias_block_sz;
+    m_buckets.resize(num_weights);
+    std::vector<double> block_weights(num_blocks);
+
+    // the alias table of each block
+    auto build_block = [&](uint64_t block_id){
+        const uint64_t start = block_id * alias_block_sz;
+        const uint64_t size = std::min(alias_block_sz, num_weights - start);
+        double total = 0;
+        for(uint64_t i = start; i < start + size; i++){ total += weight(weights[i]); }
+        block_weights[block_id] = total;
+        if(total > 0){
+            build_alias(weights + start, size, total, m_buckets.data() + start);
+        }
+    };
+    for_each_chunk(num_blocks, build_block);
+
+    // the alias table to select the block
+    double total = 0;
+    for(double w : block_weights){ total += w; }
+    if(!(total > 0)) throw std::invalid_argument("Invalid weights: at least one weight must be positive");
+    m_blocks.resize(num_blocks);
+    build_alias(block_weights.data(), num_blocks, total, m_blocks.data());
+}
+
+inline uint64_t AliasTable::draw(double u1, double u2) const {
+    using namespace details::sampling;
+    const uint64_t block_id = draw_alias(m_blocks.data(), m_blocks.size(), u1);
+    const uint64_t start = block_id * alias_block_sz;
+    return start + draw_alias(m_buckets.data() + start, std::min(alias_block_sz, m_size - start), u2);
+}
+
+template<typename Generator>
+uint64_t AliasTable::operator()(Generator& generator) const {
+    std::uniform_real_distribution<double> distribution;
+    double u1 = distribution(generator);
+    double u2 = distribution(generator);
+    return draw(u1, u2);
+}
+
+template<typename Function>
+void AliasTable::sample(uint64_t num_samples, uint64_t seed, const Function& fn) const {
+    using namespace details::sampling;
+    const uint64_t num_chunks = (num_samples + chunk_sz -1) / chunk_sz;
+    for_each_chunk(num_chunks, [&](uint64_t chunk_id){
+        RandomGenerator rnd { chunk_seed(seed, chunk_id) };
+        const uint64_t start = chunk_id * chunk_sz;
+        const uint64_t end = std::min(start + chunk_sz, num_samples);
+        for(uint64_t i = start; i < end; i++){
+            double u1 = rnd();
+            double u2 = rnd();
+            fn(i, draw(u1, u2));
+        }
+    });
+}
+
+inline void AliasTable::sample(uint64_t* output, uint64_t num_samples, uint64_t seed) const {
+    sample(num_samples, seed, [output](uint64_t i, uint64_t position){ output[i] = position; });
+}
+
+template<typename T>
+void AliasTable::sample(const T* input, T* output, uint64_t num_samples, uint64_t seed) const {
+    sample(num_samples, seed, [input, output](uint64_t i, uint64_t position){ output[i] = input[position]; });
+}
+
+inline uint64_t AliasTable::size() const noexcept {
+    return m_size;
+}
+
 } // namespace
 
 #endif //COMMON_SAMPLING_HPP
@@ -19,21 +19,90 @@
 
 #include <cstdint>
 #include <functional> // std::less
+#include <vector>
 
+#include "details/merge_impl.hpp"
 #include "details/sorting_impl.hpp"
+#include "details/sorting_radix.hpp"
 
 namespace common {
 
     /**
      * Sort in parallel the input array T. The sorting algorithm is parallel.
      *
+     * Integer keys with the default comparator (std::less) are sorted with a radix sort, all other types and comparators
+     * with a sample sort. The choice is made at compile time.
+     *
      * @param array the input array to sort
      * @param array_sz the size of the input array
      * @param fn_less a comparator function that returns true if the a < b.
+     * @param statistics if not null, it is filled with diagnostics on the partitioning of the input, e.g. the imbalance
+     *        among the buckets. The radix sort only reports the number of elements, threads and buckets.
+     */
+    template<typename T, typename FunctionLess = std::less<T>>
+    void sort(T* array, uint64_t array_sz, const FunctionLess& fn_less = FunctionLess{}, SortStatistics* statistics = nullptr){
+        if constexpr (details::sorting::radix::is_applicable<T, FunctionLess>){
+            details::sorting::radix::implementation(array, array_sz, statistics);
+        } else {
+            details::sorting::implementation(array, array_sz, fn_less, std::thread::hardware_concurrency(), statistics);
+        }
+    }
+
+    /**
+     * Retrieve the permutation that sorts the given keys, that is the keys in the order keys[permutation[0]],
+     * keys[permutation[1]], ..., keys[permutation[num_keys -1]] are sorted. The keys are not altered. The sort is stable.
+     *
+     * @param keys the keys to sort
+     * @param num_keys the number of keys
+     * @param fn_less a comparator function that returns true if the a < b.
+     */
+    template<typename T, typename FunctionLess = std::less<T>>
+    std::vector<uint64_t> argsort(const T* keys, uint64_t num_keys, const FunctionLess& fn_less = FunctionLess{}){
+        std::vector<uint64_t> permutation(num_keys);
+        details::sorting::argsort(keys, num_keys, fn_less, permutation.data());
+        return permutation;
+    }
+
+    /**
+     * Sort the keys and rearrange the arrays of values in the same order, e.g. to sort the edges by source, carrying the
+     * destinations and the weights along. The sort is stable. Each array is permuted in place, in parallel, through
+     * an auxiliary buffer of the size of a single array.
+     *
+     * @param fn_less a comparator function for the keys, that returns true if the a < b.
+     * @param keys the keys to sort
+     * @param num_keys the number of keys, and of elements in each array of values
+     * @param values the arrays to rearrange in the same order of the keys
+     */
+    template<typename FunctionLess, typename K, typename... V>
+    void sort_by_key(const FunctionLess& fn_less, K* keys, uint64_t num_keys, V*... values){
+        std::vector<uint64_t> permutation = argsort(keys, num_keys, fn_less);
+        details::sorting::apply_permutation(permutation.data(), num_keys, keys);
+        (details::sorting::apply_permutation(permutation.data(), num_keys, values), ...);
+    }
+
+    /**
+     * Sort the keys in ascending order and rearrange the arrays of values in the same order
+     */
+    template<typename K, typename... V>
+    void sort_by_key(K* keys, uint64_t num_keys, V*... values){
+        sort_by_key(std::less<K>{}, keys, num_keys, values...);
+    }
+
+    /**
+     * Merge k sorted runs into the output array, in parallel. The output is split into equal ranges, one for each
+     * thread, and each thread merges its range with a loser tree. The merge is stable: equal elements are output in
+     * the order of their runs.
+     *
+     * @param runs the sorted runs to merge
+     * @param run_sizes the number of elements in each run
+     * @param num_runs the number of runs, k
+     * @param output the output array, with a capacity of at least the total number of elements in all runs. It must not
+     *        overlap with the runs.
+     * @param fn_less the comparator function the runs are sorted with, that returns true if the a < b.
      */
-    template<typename T, typename FunctionLess>
-    void sort(T* array, uint64_t array_sz, const FunctionLess& fn_less = std::less{}){
-        details::sorting::implementation(array, array_sz, fn_less);
+    template<typename T, typename FunctionLess = std::less<T>>
+    void merge(const T* const* runs, const uint64_t* run_sizes, uint64_t num_runs, T* output, const FunctionLess& fn_less = FunctionLess{}){
+        details::merge::implementation(runs, run_sizes, num_runs, output, fn_less);
     }
 } // namespace
 
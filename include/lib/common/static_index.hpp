@@ -18,19 +18,70 @@
 #ifndef COMMON_STATIC_INDEX_HPP
 #define COMMON_STATIC_INDEX_HPP
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h> // open
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <type_traits>
+#include <unistd.h> // close, write
+#include <vector>
+
+#include "details/static_index_simd.hpp"
+#include "memory.hpp"
 
 namespace common {
 
+/**
+ * The layouts that can be used to store the keys of a StaticIndex
+ */
+namespace index_layout {
+
+/**
+ * B-ary tree, the nodes are stored in depth-first order and the rightmost subtrees are only as high as
+ * needed. This is the default layout.
+ * If NodeSize is not 0, the node size is a compile-time constant and the arithmetic to navigate the tree
+ * is resolved by the compiler into shifts and multiplications. Otherwise, the node size is given at runtime.
+ */
+template<uint16_t NodeSize = 0>
+struct BTree {
+    constexpr static uint16_t node_size = NodeSize;
+};
+
+/**
+ * B-ary tree, the nodes are stored in breadth-first order, as in the Eytzinger layout for binary trees.
+ * The children of a node are contiguous in memory. It is meant for small node sizes.
+ */
+struct Eytzinger { };
+
+/**
+ * Binary tree, the nodes are stored in the recursive (cache-oblivious) van Emde Boas order. It is meant for large trees.
+ * The node size given to the index does not affect the physical layout, it only sets the semantics with duplicate
+ * keys: #find_lte_first replays the descent of a B-Tree with that node size, to return the same position.
+ */
+struct VanEmdeBoas { };
+
+} // namespace index_layout
+
+namespace details::static_index {
+// The default node size of the indexes with the given layout
+template<typename Layout> struct default_node_size { constexpr static uint64_t value = 65; };
+template<uint16_t NodeSize> struct default_node_size<index_layout::BTree<NodeSize>> { constexpr static uint64_t value = NodeSize > 0 ? NodeSize : 65; };
+} // namespace details::static_index
+
 /**
  * A static index is an index a fixed number of entries. The key can be any fixed-length and trivially
  * copyable data table (int, double), while the values are implicitly the integers in [0, number of entries).
@@ -41,15 +92,28 @@ namespace common {
  * in terms of space, so it is recommended to set B to a power of 2 + 1 (e.g. 65) to fully
  * exploit aligned accesses to the cache.
  *
- * This class is not thread-safe.
+ * Each node is searched with a vectorised rank-counting kernel (SSE4.2, AVX2 or AVX-512), picked at
+ * runtime according to the CPU, when the key is an integer of 4 or 8 bytes, a float or a double.
+ *
+ * The template parameter Layout selects how the keys are arranged in memory, see the namespace index_layout.
+ * All layouts provide the same interface and the same semantics for the lookups.
+ *
+ * This class is not thread-safe. See ConcurrentStaticIndex for concurrent readers and a single writer.
  */
-template<typename KeyType>
+template<typename KeyType, typename Layout = index_layout::BTree<>>
 class StaticIndex {
+    static_assert(std::is_same_v<Layout, index_layout::BTree<Layout::node_size>>, "The other layouts are specialisations of this class");
+
+    constexpr static uint16_t m_fixed_node_size = Layout::node_size; // 0 => the node size is only known at runtime
     const uint16_t m_node_size; // number of keys per node
     int16_t m_height; // the height of this tree
     int32_t m_capacity; // the number of segments/keys in the tree
     KeyType* m_keys; // the container of the keys
     KeyType m_key_minimum; // the minimum stored in the tree
+    const memory::AllocationPolicy m_allocation_policy; // how to allocate m_keys
+    uint64_t m_allocation_sz; // the size of m_keys, in bytes
+    void* m_mapping; // the file mapped by #open, nullptr if the keys are owned by the index
+    uint64_t m_mapping_sz; // the size of m_mapping, in bytes
 
     /**
      * Keep track of the cardinality and the height of the rightmost subtrees
@@ -61,39 +125,217 @@ class StaticIndex {
     constexpr static uint64_t m_rightmost_sz = 8;
     RightmostSubtreeInfo m_rightmost[m_rightmost_sz];
 
+    uint64_t m_power[m_rightmost_sz +1]; // B^h, for h in [0, height]
+
+    constexpr static uint64_t m_batch_sz = 16; // number of lookups interleaved by the batched traversals
+
 protected:
+    // The header of the files written by #save, followed by the array of keys, aligned to a page
+    struct FileHeader {
+        char m_magic[8]; // file signature
+        uint32_t m_version; // version of the file format
+        uint32_t m_endianness; // the constant 0x01020304, in the byte order of the writer
+        uint32_t m_key_size; // sizeof(KeyType)
+        uint32_t m_key_kind; // 0 = unsigned integer, 1 = signed integer, 2 = floating point, 3 = other
+        uint64_t m_node_size; // the node size of the index
+        int64_t m_height; // the height of the index
+        int64_t m_capacity; // the number of entries in the index
+        RightmostSubtreeInfo m_rightmost[m_rightmost_sz]; // the shape of the rightmost subtrees
+        KeyType m_key_minimum; // the separator key of the entry 0
+        uint64_t m_keys_offset; // where the array of keys starts in the file, in bytes
+        uint64_t m_keys_sz; // the size of the array of keys, in bytes
+    };
+    constexpr static char m_file_magic[8] = { 'S', 'T', 'I', 'D', 'X', 'B', 'T', '\0' };
+    constexpr static uint32_t m_file_version = 1;
+    constexpr static uint64_t m_file_alignment = 4096;
+
+    // Retrieve the kind of key stored, for the header of the file
+    constexpr static uint32_t file_key_kind() noexcept;
+
+    // Compute the height, the powers of B and the shape of the rightmost subtrees for a tree with N entries. Return the height.
+    int init_layout(uint64_t N);
+
+    // Throw an exception if the index cannot be altered
+    void check_writable() const;
+
     // Retrieve the slot associated to the given entry
     KeyType* get_slot(uint64_t position) const;
 
+    // Retrieve the number of entries indexed by each child of a full subtree with the given height, that is B^(height -1)
+    int64_t subtree_size(int height) const noexcept;
+
+    // A subtree to fill by #build
+    struct BuildTask {
+        KeyType* m_root; // the root of the subtree
+        int m_height; // the height of the subtree
+        bool m_rightmost; // whether this is a rightmost subtree
+        const KeyType* m_separators; // the separator of the first entry indexed by the subtree, not stored in the subtree
+    };
+
+    // Number of keys stored in the root of the given subtree
+    uint64_t build_root_size(const BuildTask& task) const noexcept;
+
+    // Retrieve the i-th child of the given subtree, 0 <= i <= #build_root_size(task)
+    BuildTask build_child(const BuildTask& task, uint64_t i) const noexcept;
+
+    // Store the separator keys of the root of the given subtree
+    void build_node(const BuildTask& task) const;
+
+    // Store all separator keys of the given subtree, in the same order of the layout
+    void build_subtree(const BuildTask& task) const;
+
     // Dump the content of the given subtree
     void dump_subtree(std::ostream& out, KeyType* root, int height, bool rightmost, KeyType fence_min, KeyType fence_max, bool* integrity_check) const;
     static void dump_tabs(std::ostream& out, size_t depth);
 
+    // The position reached while descending the tree, from the root to the leaves
+    struct Cursor {
+        KeyType* m_base; // the current node
+        int64_t m_offset; // the first entry indexed by the current subtree
+        int64_t m_subtree_sz; // the number of entries indexed by each child of the current node
+        int m_height; // the height of the current subtree, 0 => the traversal is complete
+        bool m_rightmost; // whether this is the rightmost subtree
+    };
+
+    // Position the cursor at the root of the tree
+    Cursor cursor_root() const noexcept;
+
+    // Number of keys stored in the node pointed by the cursor
+    uint64_t cursor_node_size(const Cursor& cursor) const noexcept;
+
+    // Move the cursor to the given child of the current node
+    void cursor_descend(Cursor& cursor, uint64_t subtree_id) const noexcept;
+
+    // Copy the separators of the subtree pointed by the cursor, separators[i] receives the key of the entry cursor.m_offset + i, i > 0
+    void load_subtree(const Cursor& cursor, KeyType* separators) const noexcept;
+
     // Generic implementation of the method #find
     template <typename Fn>
     uint64_t traverse_tree(KeyType key, Fn fn) const noexcept;
 
+    // Generic implementation of the batched methods #find, the keys are descended in lockstep, prefetching the next node of each key
+    template <typename Fn>
+    void traverse_tree(const KeyType* keys, uint64_t num_keys, uint64_t* out, Fn fn) const noexcept;
+
+    // Search the position of the child to descend inside a node, for each variant of #find
+    static uint64_t node_search_lt(const KeyType* node, uint64_t node_sz, KeyType key) noexcept;
+    static uint64_t node_search_lte(const KeyType* node, uint64_t node_sz, KeyType key) noexcept;
+    static uint64_t node_search_lte_first(const KeyType* node, uint64_t node_sz, KeyType key) noexcept;
+    static uint64_t node_search_lte_last(const KeyType* node, uint64_t node_sz, KeyType key) noexcept;
+
 public:
     /**
-     * Initialise the AB-Tree with the given node size and capacity
+     * Visit the entries of the index in order, following the layout of the tree rather than looking up each
+     * position from the root. It remains valid as long as the index is not altered.
      */
-    StaticIndex(uint64_t node_size = 65, uint64_t num_entries = 1);
+    class Iterator {
+        friend class StaticIndex;
+
+        // A node in the path from the root to the current entry
+        struct Frame {
+            Cursor m_cursor; // the node
+            uint64_t m_next_key; // the next key to visit in the node, after all entries in the child with the same index
+        };
+
+        const StaticIndex* m_index; // the index being visited
+        Frame m_stack[m_rightmost_sz]; // the path from the root, at most one frame per level
+        int m_stack_sz; // the number of frames in the stack
+        uint64_t m_position; // the current entry
+        KeyType m_key; // the separator key of the current entry
+        KeyType m_key_max; // stop once the separator key is greater than this key
+        bool m_bounded; // whether the visit stops at m_key_max
+        bool m_valid; // whether the iterator points to an entry
+
+        // Create an empty iterator, to be positioned by StaticIndex#scan
+        Iterator(const StaticIndex* index, KeyType key_max, bool bounded) noexcept;
+
+        // Push into the stack the path to the leftmost leaf of the given subtree
+        void push_leftmost(Cursor cursor) noexcept;
+
+    public:
+        /**
+         * Check whether the iterator points to an entry
+         */
+        bool valid() const noexcept;
+
+        /**
+         * The current entry, that is a position in [0, number of entries)
+         */
+        uint64_t position() const noexcept;
+
+        /**
+         * The separator key of the current entry
+         */
+        KeyType key() const noexcept;
+
+        /**
+         * Move to the next entry. It must only be invoked when the iterator is valid.
+         */
+        void next() noexcept;
+    };
+
+    /**
+     * Initialise the AB-Tree with the given node size and capacity. If the node size is fixed at compile time by the
+     * layout, the argument node_size must be equal to it. The allocation policy determines the pages (e.g. huge pages)
+     * and the NUMA placement of the keys.
+     */
+    StaticIndex(uint64_t node_size = (m_fixed_node_size > 0 ? m_fixed_node_size : 65), uint64_t num_entries = 1, const memory::AllocationPolicy& allocation_policy = memory::AllocationPolicy{});
 
     /**
      * Destructor
      */
     ~StaticIndex();
 
+    // The container of the keys cannot be shared
+    StaticIndex(const StaticIndex&) = delete;
+    StaticIndex& operator=(const StaticIndex&) = delete;
+
+    /**
+     * Store the index into the given file, overwriting its content. The file can be reloaded with #open.
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * Map the content of a file created by #save, without copying the keys. The pages are loaded from the file on demand.
+     * The index is read-only: the methods #rebuild, #build and #set_separator_key raise an exception.
+     */
+    static std::unique_ptr<StaticIndex> open(const std::string& path);
+
+    /**
+     * Check whether the index has been loaded with #open and cannot be altered
+     */
+    bool is_read_only() const noexcept;
+
     /**
      * Rebuild the tree to contain `num_entries'
      */
     void rebuild(uint64_t num_entries);
 
+    /**
+     * Rebuild the tree to contain `num_entries' and load all the separator keys at once. The array `separators'
+     * must be sorted and contain `num_entries' keys, the i-th key is the separator of the i-th entry. The tree
+     * is filled in a single sequential pass, optionally splitting the subtrees among `num_threads' workers.
+     */
+    void build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads = 1);
+
     /**
      * Set the separator key associated to the given entry
      */
     void set_separator_key(uint64_t position, KeyType key);
 
+    /**
+     * Add a new entry at the end of the index, with the given separator key. The key must be greater or equal
+     * than the separator of the last entry. Only the rightmost subtree whose height changes is rewritten, while
+     * the whole tree is relaid out when it grows by one level, that is every time the capacity is multiplied by
+     * the node size. The amortised cost is a descent of the tree plus a constant number of key copies.
+     */
+    void append(KeyType key);
+
+    /**
+     * Retrieve the number of entries indexed
+     */
+    uint64_t capacity() const noexcept;
+
     /**
      * Get the separator key associated to the given entry.
      * Used only for the debugging purposes.
@@ -123,6 +365,27 @@ public:
      */
     uint64_t find_lte_last(KeyType key) const noexcept;
 
+    /**
+     * Batched versions of the methods #find_lt, #find_lte, #find_lte_first and #find_lte_last. The result for the key
+     * keys[i] is stored in out[i]. The keys are descended level by level in groups, prefetching the next node
+     * of each key, so that the cache misses of different lookups overlap rather than being serialised.
+     */
+    void find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+    void find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept;
+
+    /**
+     * Visit all entries of the index, from the position 0
+     */
+    Iterator scan() const noexcept;
+
+    /**
+     * Visit the entries that may contain keys in [lo, hi], that is the positions from find_lte_first(lo) to
+     * find_lte_last(hi), with a single descent of the tree. The first position is always visited.
+     */
+    Iterator scan(KeyType lo, KeyType hi) const noexcept;
+
     /**
      * Retrieve the minimum key stored in the tree
      */
@@ -143,6 +406,11 @@ public:
      */
     size_t memory_footprint() const;
 
+    /**
+     * Retrieve the policy used to allocate the keys
+     */
+    const memory::AllocationPolicy& allocation_policy() const noexcept;
+
     /**
      * Dump the fields of the index
      */
@@ -153,8 +421,8 @@ public:
 /**
  * Dump the the content of the static index
  */
-template<typename KeyType>
-std::ostream& operator<<(std::ostream& out, const StaticIndex<KeyType>& index);
+template<typename KeyType, typename Layout>
+std::ostream& operator<<(std::ostream& out, const StaticIndex<KeyType, Layout>& index);
 
 
 /*****************************************************************************
@@ -163,49 +431,85 @@ std::ostream& operator<<(std::ostream& out, const StaticIndex<KeyType>& index);
  *                                                                           *
  *****************************************************************************/
 
-template<typename KeyType>
-StaticIndex<KeyType>::StaticIndex(uint64_t node_size, uint64_t num_entries) :
-        m_node_size(node_size), m_height(0), m_capacity(0), m_keys(nullptr), m_key_minimum(std::numeric_limits<KeyType>::max()) {
+template<typename KeyType, typename Layout>
+StaticIndex<KeyType, Layout>::StaticIndex(uint64_t node_size, uint64_t num_entries, const memory::AllocationPolicy& allocation_policy) :
+        m_node_size(node_size), m_height(0), m_capacity(0), m_keys(nullptr), m_key_minimum(std::numeric_limits<KeyType>::max()),
+        m_allocation_policy(allocation_policy), m_allocation_sz(0), m_mapping(nullptr), m_mapping_sz(0), m_rightmost() {
     if(node_size > (uint64_t) std::numeric_limits<uint16_t>::max()){ throw std::invalid_argument("Invalid node size: too big"); }
+    if(node_size < 2){ throw std::invalid_argument("Invalid node size: too small"); }
+    if(m_fixed_node_size > 0 && node_size != m_fixed_node_size){ throw std::invalid_argument("Invalid node size: it does not match the layout"); }
     rebuild(num_entries);
 }
 
-template<typename KeyType>
-StaticIndex<KeyType>::~StaticIndex(){
-    free(m_keys); m_keys = nullptr;
+template<typename KeyType, typename Layout>
+StaticIndex<KeyType, Layout>::~StaticIndex(){
+    if(m_mapping != nullptr){
+        munmap(m_mapping, m_mapping_sz); m_mapping = nullptr;
+    } else {
+        memory::deallocate(m_keys, m_allocation_sz, m_allocation_policy);
+    }
+    m_keys = nullptr;
 }
 
-template<typename KeyType>
-int64_t StaticIndex<KeyType>::node_size() const noexcept {
+template<typename KeyType, typename Layout>
+int64_t StaticIndex<KeyType, Layout>::node_size() const noexcept {
     // cast to int64_t
-    return m_node_size;
+    if constexpr (m_fixed_node_size > 0){
+        return m_fixed_node_size;
+    } else {
+        return m_node_size;
+    }
+}
+
+template<typename KeyType, typename Layout>
+int64_t StaticIndex<KeyType, Layout>::subtree_size(int height) const noexcept {
+    return (height > 0) ? m_power[height -1] : 0;
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::rebuild(uint64_t N){
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::rebuild(uint64_t N){
+    check_writable();
     if(N == 0) throw std::invalid_argument("Invalid number of keys: 0");
-    int height = ceil( log2(N) / log2(node_size()) );
-    if(height > static_cast<int>(m_rightmost_sz)){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
-    uint64_t tree_sz = pow(node_size(), height) -1; // don't store the minimum, segment 0
+    if(N > static_cast<uint64_t>(std::numeric_limits<decltype(m_capacity)>::max())){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
+
+    int height = init_layout(N);
+    uint64_t tree_sz = m_power[height] -1; // don't store the minimum, segment 0
 
     if(height != m_height){
-        free(m_keys); m_keys = nullptr;
-        int rc = posix_memalign((void**) &m_keys, /* alignment */ 64,  /* size */ tree_sz * sizeof(KeyType));
-        if(rc != 0) { throw std::bad_alloc(); }
+        memory::deallocate(m_keys, m_allocation_sz, m_allocation_policy); m_keys = nullptr; m_allocation_sz = 0;
+        m_keys = reinterpret_cast<KeyType*>( memory::allocate(tree_sz * sizeof(KeyType), m_allocation_policy) );
+        m_allocation_sz = tree_sz * sizeof(KeyType);
         m_height = height;
     }
     m_capacity = N;
+}
+
+template<typename KeyType, typename Layout>
+int StaticIndex<KeyType, Layout>::init_layout(uint64_t N){
+    assert(N > 0);
+
+    // the smallest height such that B^height >= N, computed on integers
+    int height = 0;
+    uint64_t power = 1;
+    while(power < N){
+        if(height >= static_cast<int>(m_rightmost_sz)){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
+        m_power[height] = power;
+        power *= node_size();
+        height++;
+    }
+    m_power[height] = power;
+    const int result = height;
 
     // set the height of all rightmost subtrees
     while(height > 0){
-        uint64_t subtree_sz = pow(node_size(), height -1);
+        uint64_t subtree_sz = subtree_size(height);
         m_rightmost[height - 1].m_root_sz = (N -1) / subtree_sz;
         assert(m_rightmost[height -1].m_root_sz > 0);
         uint64_t rightmost_subtree_sz = (N -1) % subtree_sz;
         int rightmost_subtree_height = 0;
         if(rightmost_subtree_sz > 0){
             rightmost_subtree_sz += 1; // with B-1 keys we index B entries
-            rightmost_subtree_height = ceil(log2(rightmost_subtree_sz) / log2(m_node_size));
+            while(m_power[rightmost_subtree_height] < rightmost_subtree_sz) rightmost_subtree_height++;
         }
         m_rightmost[height -1].m_right_height = rightmost_subtree_height;
 
@@ -213,20 +517,144 @@ void StaticIndex<KeyType>::rebuild(uint64_t N){
         N = rightmost_subtree_sz;
         height = rightmost_subtree_height;
     }
+
+    return result;
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::check_writable() const {
+    if(is_read_only()){ throw std::logic_error("The index is read-only, it has been loaded from a file"); }
+}
+
+template<typename KeyType, typename Layout>
+bool StaticIndex<KeyType, Layout>::is_read_only() const noexcept {
+    return m_mapping != nullptr;
+}
+
+template<typename KeyType, typename Layout>
+constexpr uint32_t StaticIndex<KeyType, Layout>::file_key_kind() noexcept {
+    if constexpr (std::is_floating_point_v<KeyType>){
+        return 2;
+    } else if constexpr (std::is_integral_v<KeyType> && std::is_signed_v<KeyType>){
+        return 1;
+    } else if constexpr (std::is_integral_v<KeyType>){
+        return 0;
+    } else {
+        return 3;
+    }
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::save(const std::string& path) const {
+    static_assert(std::is_trivially_copyable_v<KeyType>, "The keys are stored as they are in memory");
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, m_file_magic, sizeof(header.m_magic));
+    header.m_version = m_file_version;
+    header.m_endianness = 0x01020304;
+    header.m_key_size = sizeof(KeyType);
+    header.m_key_kind = file_key_kind();
+    header.m_node_size = node_size();
+    header.m_height = m_height;
+    header.m_capacity = m_capacity;
+    memcpy(header.m_rightmost, m_rightmost, sizeof(header.m_rightmost));
+    header.m_key_minimum = m_key_minimum;
+    header.m_keys_offset = ((sizeof(FileHeader) + m_file_alignment -1) / m_file_alignment) * m_file_alignment;
+    header.m_keys_sz = memory_footprint();
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){ throw std::runtime_error(std::string("Cannot open the file `") + path + "' for writing: " + strerror(errno)); }
+    auto write_all = [fd, &path](const void* buffer, uint64_t buffer_sz){
+        const char* data = reinterpret_cast<const char*>(buffer);
+        while(buffer_sz > 0){
+            ssize_t written = ::write(fd, data, buffer_sz);
+            if(written < 0 && errno == EINTR) continue;
+            if(written < 0){
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error(std::string("Cannot write the file `") + path + "': " + strerror(error));
+            }
+            data += written;
+            buffer_sz -= written;
+        }
+    };
+    write_all(&header, sizeof(header));
+    const std::vector<char> padding(header.m_keys_offset - sizeof(header), 0);
+    write_all(padding.data(), padding.size());
+    write_all(m_keys, header.m_keys_sz);
+    if(::close(fd) != 0){ throw std::runtime_error(std::string("Cannot write the file `") + path + "': " + strerror(errno)); }
 }
 
-template<typename KeyType>
-int StaticIndex<KeyType>::height() const noexcept {
+template<typename KeyType, typename Layout>
+std::unique_ptr<StaticIndex<KeyType, Layout>> StaticIndex<KeyType, Layout>::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){ throw std::runtime_error(std::string("Cannot open the file `") + path + "': " + strerror(errno)); }
+    struct stat file_info;
+    if(fstat(fd, &file_info) != 0){
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error(std::string("Cannot stat the file `") + path + "': " + strerror(error));
+    }
+    const uint64_t file_sz = file_info.st_size;
+    if(file_sz < sizeof(FileHeader)){ ::close(fd); throw std::invalid_argument(std::string("Invalid file `") + path + "': too small"); }
+    void* mapping = mmap(nullptr, file_sz, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd); // the mapping remains valid
+    if(mapping == MAP_FAILED){ throw std::runtime_error(std::string("Cannot map the file `") + path + "': " + strerror(error)); }
+
+    std::unique_ptr<StaticIndex> index;
+    try {
+        FileHeader header;
+        memcpy(&header, mapping, sizeof(header));
+        auto check = [&path](bool condition, const char* what){
+            if(!condition) throw std::invalid_argument(std::string("Invalid file `") + path + "': " + what);
+        };
+        check(memcmp(header.m_magic, m_file_magic, sizeof(header.m_magic)) == 0, "not a static index");
+        check(header.m_version == m_file_version, "unsupported version");
+        check(header.m_endianness == 0x01020304, "different byte order");
+        check(header.m_key_size == sizeof(KeyType) && header.m_key_kind == file_key_kind(), "different key type");
+        check(header.m_capacity > 0 && header.m_capacity <= std::numeric_limits<int32_t>::max(), "invalid capacity");
+        check(header.m_keys_offset % alignof(KeyType) == 0 && header.m_keys_offset >= sizeof(header) &&
+                header.m_keys_offset <= file_sz && header.m_keys_sz <= file_sz - header.m_keys_offset, "truncated");
+
+        index.reset(new StaticIndex(header.m_node_size));
+        int height = index->init_layout(header.m_capacity);
+        check(height == header.m_height, "invalid height");
+        check(memcmp(index->m_rightmost, header.m_rightmost, sizeof(header.m_rightmost[0]) * height) == 0, "invalid shape of the rightmost subtrees");
+        check((index->m_power[height] -1) * sizeof(KeyType) == header.m_keys_sz, "invalid size of the keys");
+
+        index->m_height = height;
+        index->m_capacity = header.m_capacity;
+        index->m_key_minimum = header.m_key_minimum;
+        index->m_keys = reinterpret_cast<KeyType*>( reinterpret_cast<char*>(mapping) + header.m_keys_offset );
+        index->m_mapping = mapping;
+        index->m_mapping_sz = file_sz;
+    } catch(...){
+        if(index.get() == nullptr || index->m_mapping == nullptr){ munmap(mapping, file_sz); }
+        throw;
+    }
+
+    return index;
+}
+
+template<typename KeyType, typename Layout>
+int StaticIndex<KeyType, Layout>::height() const noexcept {
     return m_height;
 }
 
-template<typename KeyType>
-size_t StaticIndex<KeyType>::memory_footprint() const {
-    return (pow(node_size(), height()) -1) * sizeof(KeyType);
+template<typename KeyType, typename Layout>
+size_t StaticIndex<KeyType, Layout>::memory_footprint() const {
+    return (m_power[height()] -1) * sizeof(KeyType);
 }
 
-template<typename KeyType>
-KeyType* StaticIndex<KeyType>::get_slot(uint64_t entry_id) const {
+template<typename KeyType, typename Layout>
+const memory::AllocationPolicy& StaticIndex<KeyType, Layout>::allocation_policy() const noexcept {
+    return m_allocation_policy;
+}
+
+template<typename KeyType, typename Layout>
+KeyType* StaticIndex<KeyType, Layout>::get_slot(uint64_t entry_id) const {
     assert(entry_id > 0 && "The segment 0 is not explicitly stored");
     assert(entry_id < static_cast<uint64_t>(m_capacity) && "Invalid slot");
 
@@ -234,7 +662,7 @@ KeyType* StaticIndex<KeyType>::get_slot(uint64_t entry_id) const {
     int64_t offset = entry_id;
     int height = m_height;
     bool rightmost = true; // this is the rightmost subtree
-    int64_t subtree_sz = pow(node_size(), height -1);
+    int64_t subtree_sz = subtree_size(height);
 
     while(height > 0){
         int64_t subtree_id = offset / subtree_sz;
@@ -253,7 +681,7 @@ KeyType* StaticIndex<KeyType>::get_slot(uint64_t entry_id) const {
         rightmost = rightmost && (subtree_id >= m_rightmost[height -1].m_root_sz);
         if(rightmost){
             height = m_rightmost[height -1].m_right_height;
-            subtree_sz = pow(node_size(), height -1);
+            subtree_sz = subtree_size(height);
         } else {
             height --;
             subtree_sz /= node_size();
@@ -263,8 +691,87 @@ KeyType* StaticIndex<KeyType>::get_slot(uint64_t entry_id) const {
     return base + offset;
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::set_separator_key(uint64_t position, KeyType key){
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::build(const KeyType* separators, uint64_t num_entries, uint64_t num_threads){
+    rebuild(num_entries);
+    m_key_minimum = separators[0];
+    if(m_height == 0) return; // only the minimum
+
+    // expand the top levels of the tree, until there are enough subtrees to feed all workers
+    std::vector<BuildTask> tasks { BuildTask{ m_keys, m_height, true, separators } };
+    const uint64_t min_num_tasks = (num_threads > 1) ? num_threads * 4 : 1; // the rightmost subtrees can be smaller
+    while(tasks.size() < min_num_tasks && std::all_of(begin(tasks), end(tasks), [](const BuildTask& t){ return t.m_height > 1; })){
+        std::vector<BuildTask> children;
+        for(auto& task: tasks){
+            build_node(task);
+            for(uint64_t i = 0, root_sz = build_root_size(task); i <= root_sz; i++){
+                BuildTask child = build_child(task, i);
+                if(child.m_height > 0) children.push_back(child);
+            }
+        }
+        tasks = std::move(children);
+    }
+
+    if(num_threads <= 1 || tasks.size() == 1){
+        for(auto& task : tasks){ build_subtree(task); }
+    } else {
+        // each worker fills a contiguous range of subtrees
+        std::vector<std::future<void>> workers;
+        const uint64_t num_tasks = tasks.size();
+        for(uint64_t worker_id = 0; worker_id < num_threads; worker_id++){
+            uint64_t start = num_tasks * worker_id / num_threads;
+            uint64_t end = num_tasks * (worker_id +1) / num_threads;
+            if(start == end) continue;
+            workers.push_back(std::async(std::launch::async, [this, &tasks, start, end](){
+                for(uint64_t i = start; i < end; i++){ build_subtree(tasks[i]); }
+            }));
+        }
+        for(auto& w : workers){ w.get(); }
+    }
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::build_root_size(const BuildTask& task) const noexcept {
+    return (task.m_rightmost) ? m_rightmost[task.m_height -1].m_root_sz : node_size() -1; // full
+}
+
+template<typename KeyType, typename Layout>
+typename StaticIndex<KeyType, Layout>::BuildTask StaticIndex<KeyType, Layout>::build_child(const BuildTask& task, uint64_t i) const noexcept {
+    const uint64_t root_sz = build_root_size(task);
+    const int64_t subtree_sz = subtree_size(task.m_height);
+    BuildTask child;
+    child.m_root = task.m_root + (node_size() -1) + i * (subtree_sz -1);
+    child.m_rightmost = task.m_rightmost && i >= root_sz;
+    child.m_height = (child.m_rightmost) ? m_rightmost[task.m_height -1].m_right_height : task.m_height -1;
+    child.m_separators = task.m_separators + i * subtree_sz;
+    return child;
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::build_node(const BuildTask& task) const {
+    const uint64_t root_sz = build_root_size(task);
+    const int64_t subtree_sz = subtree_size(task.m_height);
+
+    // the i-th key of the root is the separator of the entry (i+1) * subtree_sz
+    for(uint64_t i = 0; i < root_sz; i++){
+        task.m_root[i] = task.m_separators[(i+1) * subtree_sz];
+    }
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::build_subtree(const BuildTask& task) const {
+    if(task.m_height <= 0) return; // empty subtree
+    build_node(task);
+    if(task.m_height > 1){ // internal node
+        for(uint64_t i = 0, root_sz = build_root_size(task); i <= root_sz; i++){
+            build_subtree(build_child(task, i));
+        }
+    }
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::set_separator_key(uint64_t position, KeyType key){
+    check_writable();
     if(position == 0) {
         m_key_minimum = key;
     } else {
@@ -274,96 +781,347 @@ void StaticIndex<KeyType>::set_separator_key(uint64_t position, KeyType key){
     assert(get_separator_key(position) == key);
 }
 
-template<typename KeyType>
-KeyType StaticIndex<KeyType>::get_separator_key(uint64_t position) const {
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::append(KeyType key){
+    check_writable();
+    const uint64_t N = m_capacity; // the position of the new entry
+    if(N >= static_cast<uint64_t>(std::numeric_limits<decltype(m_capacity)>::max())){ throw std::invalid_argument("Invalid number of keys/segments: too big"); }
+    if(key < get_separator_key(N -1)){ throw std::invalid_argument("The separator keys must be appended in sorted order"); }
+
+    if(N +1 > m_power[m_height]){ // the tree needs one more level, relayout everything
+        std::vector<KeyType> separators;
+        separators.reserve(N +1);
+        for(auto it = scan(); it.valid(); it.next()){ separators.push_back(it.key()); }
+        separators.push_back(key);
+        build(separators.data(), N +1);
+        return;
+    }
+
+    // the new shape of the rightmost subtrees, the height and the powers of B do not change
+    RightmostSubtreeInfo old_shape[m_rightmost_sz];
+    RightmostSubtreeInfo new_shape[m_rightmost_sz];
+    memcpy(old_shape, m_rightmost, sizeof(m_rightmost));
+    init_layout(N +1);
+    memcpy(new_shape, m_rightmost, sizeof(m_rightmost));
+    memcpy(m_rightmost, old_shape, sizeof(m_rightmost));
+
+    // find the topmost subtree in the rightmost spine whose shape changes
+    auto same_shape = [&](int height){
+        return old_shape[height -1].m_root_sz == new_shape[height -1].m_root_sz && old_shape[height -1].m_right_height == new_shape[height -1].m_right_height;
+    };
+    Cursor cursor = cursor_root();
+    while(cursor.m_height > 0 && same_shape(cursor.m_height)){
+        cursor_descend(cursor, cursor_node_size(cursor));
+    }
+    assert(cursor.m_height > 0 && "The shape must change somewhere in the rightmost spine");
+    const uint64_t old_root_sz = old_shape[cursor.m_height -1].m_root_sz;
+
+    if(new_shape[cursor.m_height -1].m_root_sz != old_root_sz){
+        // the rightmost child became full, a full subtree has the same layout of a rightmost subtree with the same
+        // number of entries, and the new entry is the first of a new empty rightmost child
+        assert(new_shape[cursor.m_height -1].m_root_sz == old_root_sz +1);
+        assert(new_shape[cursor.m_height -1].m_right_height == 0);
+        memcpy(m_rightmost, new_shape, sizeof(m_rightmost));
+        m_capacity = N +1;
+        cursor.m_base[old_root_sz] = key;
+    } else {
+        // the rightmost child is one level higher, rewrite it with the new shape, it occupies the same slots
+        const int new_height = new_shape[cursor.m_height -1].m_right_height;
+        cursor_descend(cursor, old_root_sz);
+        std::vector<KeyType> separators(N +1 - cursor.m_offset);
+        load_subtree(cursor, separators.data());
+        separators[N - cursor.m_offset] = key;
+        memcpy(m_rightmost, new_shape, sizeof(m_rightmost));
+        m_capacity = N +1;
+        build_subtree(BuildTask{ cursor.m_base, new_height, /* rightmost ? */ true, separators.data() });
+    }
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::capacity() const noexcept {
+    return m_capacity;
+}
+
+template<typename KeyType, typename Layout>
+KeyType StaticIndex<KeyType, Layout>::get_separator_key(uint64_t position) const {
     if(position == 0)
         return m_key_minimum;
     else
         return get_slot(position)[0];
 }
 
-template <typename KeyType>
+template<typename KeyType, typename Layout>
+typename StaticIndex<KeyType, Layout>::Cursor StaticIndex<KeyType, Layout>::cursor_root() const noexcept {
+    Cursor cursor;
+    cursor.m_base = m_keys;
+    cursor.m_offset = 0;
+    cursor.m_height = m_height;
+    cursor.m_rightmost = true;
+    cursor.m_subtree_sz = subtree_size(cursor.m_height);
+    return cursor;
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::cursor_node_size(const Cursor& cursor) const noexcept {
+    return (cursor.m_rightmost) ? m_rightmost[cursor.m_height -1].m_root_sz : node_size() -1; // full
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::cursor_descend(Cursor& cursor, uint64_t subtree_id) const noexcept {
+    cursor.m_base += (node_size() -1) + subtree_id * (cursor.m_subtree_sz -1);
+    cursor.m_offset += subtree_id * cursor.m_subtree_sz;
+
+    // similar to #get_slot
+    cursor.m_rightmost = cursor.m_rightmost && (subtree_id >= m_rightmost[cursor.m_height -1].m_root_sz);
+    if(cursor.m_rightmost){
+        cursor.m_height = m_rightmost[cursor.m_height -1].m_right_height;
+        cursor.m_subtree_sz = subtree_size(cursor.m_height);
+    } else {
+        cursor.m_height --;
+        cursor.m_subtree_sz /= node_size();
+    }
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::load_subtree(const Cursor& cursor, KeyType* separators) const noexcept {
+    if(cursor.m_height == 0) return; // empty subtree
+    const uint64_t node_sz = cursor_node_size(cursor);
+    for(uint64_t i = 0; i < node_sz; i++){
+        separators[(i +1) * cursor.m_subtree_sz] = cursor.m_base[i];
+    }
+    for(uint64_t i = 0; i <= node_sz; i++){
+        Cursor child = cursor;
+        cursor_descend(child, i);
+        load_subtree(child, separators + i * cursor.m_subtree_sz);
+    }
+}
+
+template<typename KeyType, typename Layout>
 template <typename Fn>
-uint64_t StaticIndex<KeyType>::traverse_tree(KeyType key, Fn fn) const noexcept{
-    KeyType* __restrict base = m_keys;
-    int64_t offset = 0;
-    int height = m_height;
-    bool rightmost = true; // this is the rightmost subtree
-    int64_t subtree_sz = pow(node_size(), height -1);
+uint64_t StaticIndex<KeyType, Layout>::traverse_tree(KeyType key, Fn fn) const noexcept{
+    Cursor cursor = cursor_root();
 
-    while(height > 0){
-        uint64_t root_sz = (rightmost) ? m_rightmost[height -1].m_root_sz : node_size() -1; // full
-        uint64_t subtree_id = fn(base, root_sz, key);
+    while(cursor.m_height > 0){
+        uint64_t subtree_id = fn(cursor.m_base, cursor_node_size(cursor), key);
+        cursor_descend(cursor, subtree_id);
+    }
 
-        base += (node_size() -1) + subtree_id * (subtree_sz -1);
-        offset += subtree_id * subtree_sz;
+    return cursor.m_offset;
+}
 
-        // similar to #get_slot
-        rightmost = rightmost && (subtree_id >= m_rightmost[height -1].m_root_sz);
-        if(rightmost){
-            height = m_rightmost[height -1].m_right_height;
-            subtree_sz = pow(node_size(), height -1);
-        } else {
-            height --;
-            subtree_sz /= node_size();
+template<typename KeyType, typename Layout>
+template <typename Fn>
+void StaticIndex<KeyType, Layout>::traverse_tree(const KeyType* keys, uint64_t num_keys, uint64_t* out, Fn fn) const noexcept {
+    Cursor cursors[m_batch_sz];
+
+    for(uint64_t batch_start = 0; batch_start < num_keys; batch_start += m_batch_sz){
+        const uint64_t batch_sz = std::min<uint64_t>(m_batch_sz, num_keys - batch_start);
+        for(uint64_t i = 0; i < batch_sz; i++){ cursors[i] = cursor_root(); }
+
+        // all cursors advance one level per round, the heights may differ in the rightmost subtrees
+        uint64_t num_active = (m_height > 0) ? batch_sz : 0;
+        while(num_active > 0){
+            num_active = 0;
+            for(uint64_t i = 0; i < batch_sz; i++){
+                Cursor& cursor = cursors[i];
+                if(cursor.m_height == 0) continue; // this lookup is already complete
+
+                uint64_t subtree_id = fn(cursor.m_base, cursor_node_size(cursor), keys[batch_start + i]);
+                cursor_descend(cursor, subtree_id);
+
+                if(cursor.m_height > 0){
+                    // request the next node, it will be searched after the nodes of the other keys in the batch
+                    const char* node = reinterpret_cast<const char*>(cursor.m_base);
+                    const uint64_t node_bytes = cursor_node_size(cursor) * sizeof(KeyType);
+                    for(uint64_t line = 0; line < node_bytes; line += 64){ __builtin_prefetch(node + line); }
+                    num_active++;
+                }
+            }
         }
+
+        for(uint64_t i = 0; i < batch_sz; i++){ out[batch_start + i] = cursors[i].m_offset; }
     }
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::node_search_lt(const KeyType* node, uint64_t node_sz, KeyType key) noexcept {
+    return details::static_index::rank</* inclusive */ false>(node, node_sz, key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::node_search_lte(const KeyType* node, uint64_t node_sz, KeyType key) noexcept {
+    return details::static_index::rank</* inclusive */ true>(node, node_sz, key);
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::node_search_lte_first(const KeyType* node, uint64_t node_sz, KeyType key) noexcept {
+    uint64_t position = details::static_index::rank</* inclusive */ false>(node, node_sz, key);
+    if(position < node_sz && node[position] == key) { position++; }
+    return position;
+}
 
-    return offset;
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::node_search_lte_last(const KeyType* node, uint64_t node_sz, KeyType key) noexcept {
+    // the keys in the node are sorted: the last position such that key >= node[position -1]
+    return details::static_index::rank</* inclusive */ true>(node, node_sz, key);
 }
 
-template<typename KeyType>
-uint64_t StaticIndex<KeyType>::find_lt(KeyType key) const noexcept {
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::find_lt(KeyType key) const noexcept {
     if(key < m_key_minimum) return 0; // easy!
+    return traverse_tree(key, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lt(node, node_sz, key);
+    });
+}
 
-    return traverse_tree(key, [](KeyType* __restrict node, uint64_t node_sz, KeyType key){
-        uint64_t position = 0;
-        while(position < node_sz && node[position] < key) position++;
-        return position;
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::find_lte(KeyType key) const noexcept {
+    if(key <= m_key_minimum) return 0; // easy!
+    return traverse_tree(key, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte(node, node_sz, key);
     });
 }
 
-template<typename KeyType>
-uint64_t StaticIndex<KeyType>::find_lte(KeyType key) const noexcept {
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::find_lte_first(KeyType key) const noexcept {
     if(key <= m_key_minimum) return 0; // easy!
+    return traverse_tree(key, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte_first(node, node_sz, key);
+    });
+}
 
-    return traverse_tree(key, [](KeyType* __restrict node, uint64_t node_sz, KeyType key){
-        uint64_t position = 0;
-        while(position < node_sz && node[position] <= key) position++;
-        return position;
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::find_lte_last(KeyType key) const noexcept {
+    if(key < m_key_minimum) return 0; // easy!
+    return traverse_tree(key, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte_last(node, node_sz, key);
     });
 }
 
-template<typename KeyType>
-uint64_t StaticIndex<KeyType>::find_lte_first(KeyType key) const noexcept {
-    if(key <= m_key_minimum) return 0; // easy!
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::find_lt(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    traverse_tree(keys, num_keys, out, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lt(node, node_sz, key);
+    });
+    for(uint64_t i = 0; i < num_keys; i++){ if(keys[i] < m_key_minimum) out[i] = 0; }
+}
 
-    return traverse_tree(key, [](KeyType* __restrict node, uint64_t node_sz, KeyType key){
-        uint64_t position = 0;
-        while(position < node_sz && node[position] < key) { position++; }
-        if(position < node_sz && node[position] == key) { position++; }
-        return position;
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::find_lte(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    traverse_tree(keys, num_keys, out, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte(node, node_sz, key);
     });
+    for(uint64_t i = 0; i < num_keys; i++){ if(keys[i] <= m_key_minimum) out[i] = 0; }
 }
 
-template<typename KeyType>
-uint64_t StaticIndex<KeyType>::find_lte_last(KeyType key) const noexcept {
-    if(key < m_key_minimum) return 0; // easy!
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::find_lte_first(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    traverse_tree(keys, num_keys, out, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte_first(node, node_sz, key);
+    });
+    for(uint64_t i = 0; i < num_keys; i++){ if(keys[i] <= m_key_minimum) out[i] = 0; }
+}
 
-    return traverse_tree(key, [](KeyType* __restrict node, uint64_t node_sz, KeyType key){
-        uint64_t position = node_sz;
-        while(position > 0 && key < node[position -1]) position--;
-        return position;
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::find_lte_last(const KeyType* keys, uint64_t num_keys, uint64_t* out) const noexcept {
+    traverse_tree(keys, num_keys, out, [](const KeyType* node, uint64_t node_sz, KeyType key){
+        return node_search_lte_last(node, node_sz, key);
     });
+    for(uint64_t i = 0; i < num_keys; i++){ if(keys[i] < m_key_minimum) out[i] = 0; }
 }
 
-template<typename KeyType>
-KeyType StaticIndex<KeyType>::minimum() const noexcept {
+template<typename KeyType, typename Layout>
+typename StaticIndex<KeyType, Layout>::Iterator StaticIndex<KeyType, Layout>::scan() const noexcept {
+    Iterator it { this, m_key_minimum, /* bounded ? */ false };
+    it.push_leftmost(cursor_root());
+    return it;
+}
+
+template<typename KeyType, typename Layout>
+typename StaticIndex<KeyType, Layout>::Iterator StaticIndex<KeyType, Layout>::scan(KeyType lo, KeyType hi) const noexcept {
+    Iterator it { this, hi, /* bounded ? */ true };
+
+    if(lo <= m_key_minimum){
+        it.push_leftmost(cursor_root());
+    } else { // same descent of #find_lte_first, recording the path
+        Cursor cursor = cursor_root();
+        while(cursor.m_height > 0){
+            uint64_t subtree_id = node_search_lte_first(cursor.m_base, cursor_node_size(cursor), lo);
+            it.m_stack[it.m_stack_sz++] = typename Iterator::Frame{ cursor, subtree_id };
+            if(subtree_id > 0){ it.m_key = cursor.m_base[subtree_id -1]; } // the separator of the first entry in the child
+            cursor_descend(cursor, subtree_id);
+        }
+        it.m_position = cursor.m_offset;
+    }
+
+    return it;
+}
+
+template<typename KeyType, typename Layout>
+StaticIndex<KeyType, Layout>::Iterator::Iterator(const StaticIndex* index, KeyType key_max, bool bounded) noexcept :
+    m_index(index), m_stack_sz(0), m_position(0), m_key(index->m_key_minimum), m_key_max(key_max), m_bounded(bounded), m_valid(true) {
+
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::Iterator::push_leftmost(Cursor cursor) noexcept {
+    while(cursor.m_height > 0){
+        assert(m_stack_sz < static_cast<int>(m_rightmost_sz) && "Stack overflow");
+        m_stack[m_stack_sz++] = Frame{ cursor, 0 };
+        m_index->cursor_descend(cursor, 0);
+    }
+}
+
+template<typename KeyType, typename Layout>
+bool StaticIndex<KeyType, Layout>::Iterator::valid() const noexcept {
+    return m_valid;
+}
+
+template<typename KeyType, typename Layout>
+uint64_t StaticIndex<KeyType, Layout>::Iterator::position() const noexcept {
+    assert(valid());
+    return m_position;
+}
+
+template<typename KeyType, typename Layout>
+KeyType StaticIndex<KeyType, Layout>::Iterator::key() const noexcept {
+    assert(valid());
+    return m_key;
+}
+
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::Iterator::next() noexcept {
+    assert(valid());
+
+    while(m_stack_sz > 0){
+        Frame& frame = m_stack[m_stack_sz -1];
+        if(frame.m_next_key < m_index->cursor_node_size(frame.m_cursor)){
+            // the key separates the child m_next_key from the child m_next_key +1
+            uint64_t key_id = frame.m_next_key++;
+            m_position = frame.m_cursor.m_offset + (key_id +1) * frame.m_cursor.m_subtree_sz;
+            m_key = frame.m_cursor.m_base[key_id];
+            m_valid = !m_bounded || m_key <= m_key_max;
+
+            // the entries of the next child follow the current one
+            Cursor child = frame.m_cursor;
+            m_index->cursor_descend(child, key_id +1);
+            push_leftmost(child);
+            return;
+        }
+
+        m_stack_sz--; // all entries in this subtree have been visited
+    }
+
+    m_valid = false; // depleted
+}
+
+template<typename KeyType, typename Layout>
+KeyType StaticIndex<KeyType, Layout>::minimum() const noexcept {
     return m_key_minimum;
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::dump_tabs(std::ostream& out, size_t depth){
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::dump_tabs(std::ostream& out, size_t depth){
     using namespace std;
 
     auto flags = out.flags();
@@ -371,14 +1129,14 @@ void StaticIndex<KeyType>::dump_tabs(std::ostream& out, size_t depth){
     out.setf(flags);
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::dump_subtree(std::ostream& out, KeyType* root, int height, bool rightmost, KeyType fence_min, KeyType fence_max, bool* integrity_check) const {
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::dump_subtree(std::ostream& out, KeyType* root, int height, bool rightmost, KeyType fence_min, KeyType fence_max, bool* integrity_check) const {
     using namespace std;
     if(height <= 0) return; // base case
 
     int depth = m_height - height +1;
     int64_t root_sz = (rightmost) ? m_rightmost[height -1].m_root_sz : node_size() -1; // full
-    int64_t subtree_sz = pow(node_size(), height -1);
+    int64_t subtree_sz = subtree_size(height);
 
     // preamble
     auto flags = out.flags();
@@ -434,8 +1192,8 @@ void StaticIndex<KeyType>::dump_subtree(std::ostream& out, KeyType* root, int he
     }
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::dump(std::ostream& out, bool* integrity_check) const {
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::dump(std::ostream& out, bool* integrity_check) const {
     out << "[Index] block size: " << node_size() << ", height: " << height() <<
             ", capacity (number of entries indexed): " << m_capacity << ", minimum: " << minimum() << "\n";
 
@@ -443,17 +1201,20 @@ void StaticIndex<KeyType>::dump(std::ostream& out, bool* integrity_check) const
         dump_subtree(out, m_keys, height(), true, m_key_minimum, std::numeric_limits<KeyType>::max(), integrity_check);
 }
 
-template<typename KeyType>
-void StaticIndex<KeyType>::dump() const {
+template<typename KeyType, typename Layout>
+void StaticIndex<KeyType, Layout>::dump() const {
     dump(std::cout);
 }
 
-template<typename KeyType>
-std::ostream& operator<<(std::ostream& out, const StaticIndex<KeyType>& index){
+template<typename KeyType, typename Layout>
+std::ostream& operator<<(std::ostream& out, const StaticIndex<KeyType, Layout>& index){
     index.dump(out);
     return out;
 }
 
 } // namespace common
 
+// Specialisations for the layouts Eytzinger and van Emde Boas
+#include "details/static_index_implicit.hpp"
+
 #endif /* COMMON_STATIC_INDEX_HPP */
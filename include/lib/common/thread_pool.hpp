@@ -0,0 +1,176 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_THREAD_POOL_HPP
+#define COMMON_THREAD_POOL_HPP
+
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+/**
+ * A pool of worker threads executing tasks, with work stealing. Each worker owns a queue of tasks. A task submitted by
+ * a worker is pushed into its own queue, the other tasks are distributed round robin among the queues of the workers.
+ * A worker executes the tasks in its own queue in LIFO order and, once its queue is empty, steals the oldest tasks
+ * from the queues of the other workers.
+ *
+ * The pool is meant to be used through a TaskGroup, to wait for the completion of a set of tasks. Tasks can spawn and wait
+ * for other tasks: a thread waiting for a TaskGroup keeps executing the pending tasks in the meanwhile.
+ *
+ * The class is thread safe.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    // The queue of tasks owned by a worker
+    struct alignas(64) Queue {
+        std::mutex m_mutex; // protect the access to m_tasks
+        std::deque<Task> m_tasks; // the tasks to execute
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_queues; // one queue for each worker
+    std::vector<std::thread> m_workers; // the worker threads
+    std::atomic<uint64_t> m_num_pending; // the number of tasks in the queues, not yet executed
+    std::atomic<uint64_t> m_num_idle; // the number of workers sleeping in m_idle_condvar
+    std::atomic<uint64_t> m_next_queue; // where to submit the next task from a thread external to the pool
+    std::atomic<bool> m_terminate; // whether the workers should stop
+    std::mutex m_idle_mutex; // to sleep when there are no tasks to execute
+    std::condition_variable m_idle_condvar; // to wake up the workers sleeping
+
+    // The main loop of a worker
+    void worker_main(uint64_t worker_id);
+
+    // Retrieve a task from the given queue, either from the back (LIFO, for the owner) or from the front (FIFO, for the thieves)
+    bool pop_task(uint64_t queue_id, bool from_back, Task& task);
+
+    // Retrieve a task, first from the given queue, then stealing from the other queues
+    bool find_task(uint64_t queue_id, Task& task);
+
+public:
+    /**
+     * Create a pool with the given number of workers. With zero workers, the tasks are only executed by the threads
+     * waiting for them.
+     */
+    ThreadPool(uint64_t num_threads = std::thread::hardware_concurrency());
+
+    /**
+     * Stop the workers. The tasks not yet started are discarded.
+     */
+    ~ThreadPool();
+
+    // Not copyable
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Submit a new task for execution. Better use a TaskGroup, to wait for its completion.
+     */
+    void submit(Task task);
+
+    /**
+     * Execute a pending task, if any, in the calling thread. Return true if a task has been executed, false if there were
+     * no pending tasks.
+     */
+    bool execute_pending_task();
+
+    /**
+     * Retrieve the number of workers in the pool
+     */
+    uint64_t num_threads() const noexcept;
+
+    /**
+     * Retrieve the pool shared by the library, with one worker for each hardware thread. It is created on first use.
+     */
+    static ThreadPool& global();
+};
+
+/**
+ * A set of tasks executed by a ThreadPool, whose completion can be waited
+ */
+class TaskGroup {
+    ThreadPool& m_pool; // the pool executing the tasks
+    std::atomic<uint64_t> m_num_active; // number of tasks submitted and not completed yet
+    std::mutex m_mutex; // protect m_exception
+    std::exception_ptr m_exception; // the first exception raised by a task
+
+public:
+    /**
+     * Create a new group of tasks, to be executed by the given pool
+     */
+    TaskGroup(ThreadPool& pool = ThreadPool::global());
+
+    /**
+     * Wait for the completion of all tasks. The exceptions raised by the tasks are ignored.
+     */
+    ~TaskGroup();
+
+    // Not copyable
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * Submit a new task to the pool
+     */
+    template<typename Function>
+    void run(Function&& fn);
+
+    /**
+     * Wait for all tasks submitted to complete, executing the pending tasks of the pool in the meanwhile. If a task
+     * raised an exception, rethrow it.
+     */
+    void wait();
+
+    /**
+     * Retrieve the pool executing the tasks
+     */
+    ThreadPool& pool() noexcept;
+};
+
+/*****************************************************************************
+ *                                                                           *
+ *   Implementation details                                                  *
+ *                                                                           *
+ *****************************************************************************/
+
+template<typename Function>
+void TaskGroup::run(Function&& fn){
+    m_num_active++;
+    m_pool.submit([this, fn = std::forward<Function>(fn)]() mutable {
+        try {
+            fn();
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(!m_exception){ m_exception = std::current_exception(); }
+        }
+        m_num_active--;
+    });
+}
+
+} // namespace common
+
+#endif //COMMON_THREAD_POOL_HPP
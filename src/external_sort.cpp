@@ -0,0 +1,105 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "external_sort.hpp"
+
+#include <cerrno>
+#include <cstdlib> // getenv, mkstemp
+#include <cstring> // strerror
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.hpp"
+
+using namespace std;
+
+namespace common::details::external_sort {
+
+static string temporary_directory(const string& path){
+    if(!path.empty()) return path;
+    const char* tmpdir = getenv("TMPDIR");
+    return (tmpdir != nullptr && tmpdir[0] != '\0') ? string(tmpdir) : string("/tmp");
+}
+
+File::File(const string& path, Mode mode) : m_fd(-1), m_path(path) {
+    switch(mode){
+    case Mode::READ:
+        m_fd = ::open(path.c_str(), O_RDONLY);
+        break;
+    case Mode::WRITE:
+        m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        break;
+    case Mode::TEMPORARY: {
+        m_path = temporary_directory(path) + "/libcommon_sort_XXXXXX";
+        unique_ptr<char[]> name { new char[m_path.size() +1] };
+        memcpy(name.get(), m_path.c_str(), m_path.size() +1);
+        m_fd = mkstemp(name.get());
+        if(m_fd >= 0){
+            m_path = name.get();
+            unlink(name.get()); // the file is removed once closed
+        }
+    } break;
+    }
+
+    if(m_fd < 0) ERROR("Cannot open the file " << m_path << ": " << strerror(errno));
+}
+
+File::File(File&& other) noexcept : m_fd(other.m_fd), m_path(std::move(other.m_path)) {
+    other.m_fd = -1;
+}
+
+File::~File(){
+    if(m_fd >= 0){ ::close(m_fd); m_fd = -1; }
+}
+
+uint64_t File::size() const {
+    struct stat result;
+    if(fstat(m_fd, &result) != 0) ERROR("Cannot retrieve the size of the file " << m_path << ": " << strerror(errno));
+    return result.st_size;
+}
+
+uint64_t File::read(void* buffer, uint64_t num_bytes, uint64_t offset) const {
+    char* ptr = reinterpret_cast<char*>(buffer);
+    uint64_t total = 0;
+    while(total < num_bytes){
+        ssize_t rc = ::pread(m_fd, ptr + total, num_bytes - total, offset + total);
+        if(rc < 0){
+            if(errno == EINTR) continue;
+            ERROR("Cannot read from the file " << m_path << ": " << strerror(errno));
+        } else if(rc == 0){ // end of file
+            break;
+        }
+        total += rc;
+    }
+    return total;
+}
+
+void File::write(const void* buffer, uint64_t num_bytes, uint64_t offset){
+    const char* ptr = reinterpret_cast<const char*>(buffer);
+    uint64_t total = 0;
+    while(total < num_bytes){
+        ssize_t rc = ::pwrite(m_fd, ptr + total, num_bytes - total, offset + total);
+        if(rc < 0){
+            if(errno == EINTR) continue;
+            ERROR("Cannot write to the file " << m_path << ": " << strerror(errno));
+        }
+        total += rc;
+    }
+}
+
+} // namespace common::details::external_sort
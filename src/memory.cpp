@@ -0,0 +1,141 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "memory.hpp"
+
+#include <cstdlib> // posix_memalign
+#include <new> // std::bad_alloc
+#include <sys/mman.h>
+#include <unistd.h> // sysconf
+
+// Support for libnuma
+#if __has_include(<numa.h>)
+#include <numa.h>
+#if !defined(HAVE_LIBNUMA)
+#define HAVE_LIBNUMA
+#endif
+#endif
+
+using namespace std;
+
+namespace common::memory {
+
+uint64_t page_size(PageSize page_size){
+    switch(page_size){
+    case PageSize::DEFAULT: return 64; // cache line
+    case PageSize::TRANSPARENT: return 2ull << 20; // align to the huge pages
+    case PageSize::HUGE_2MB: return 2ull << 20;
+    case PageSize::HUGE_1GB: return 1ull << 30;
+    default: return static_cast<uint64_t>( sysconf(_SC_PAGESIZE) );
+    }
+}
+
+// The amount of memory actually mapped for the given request
+static uint64_t mapping_size(uint64_t size, const AllocationPolicy& policy){
+    const uint64_t granularity = page_size(policy.m_page_size);
+    return ((size + granularity -1) / granularity) * granularity;
+}
+
+// Apply the NUMA policy to the given mapping, before its pages are touched
+static void set_numa_policy(void* ptr, uint64_t size, const AllocationPolicy& policy){
+#if defined(HAVE_LIBNUMA)
+    if(policy.m_numa_policy == NumaPolicy::DEFAULT || numa_available() == -1) return;
+
+    if(policy.m_numa_policy == NumaPolicy::INTERLEAVE){
+        numa_interleave_memory(ptr, size, numa_all_nodes_ptr);
+    } else if(policy.m_numa_policy == NumaPolicy::BIND && policy.m_numa_node >= 0 && policy.m_numa_node <= numa_max_node()){
+        numa_tonode_memory(ptr, size, policy.m_numa_node);
+    }
+#endif
+}
+
+void* allocate(uint64_t size, const AllocationPolicy& policy){
+    if(size == 0) size = 1; // still return a valid pointer
+
+    if(policy.m_page_size == PageSize::DEFAULT && policy.m_numa_policy == NumaPolicy::DEFAULT){
+        void* ptr = nullptr;
+        int rc = posix_memalign(&ptr, /* alignment */ 64, size);
+        if(rc != 0) { throw std::bad_alloc(); }
+        return ptr;
+    }
+
+    const uint64_t length = mapping_size(size, policy);
+    void* ptr = MAP_FAILED;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if(policy.m_page_size == PageSize::HUGE_2MB || policy.m_page_size == PageSize::HUGE_1GB){
+        int log2_page_sz = (policy.m_page_size == PageSize::HUGE_2MB) ? 21 : 30;
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log2_page_sz << MAP_HUGE_SHIFT), -1, 0);
+    }
+#endif
+
+    if(ptr == MAP_FAILED){ // regular pages, or no huge pages reserved in the system
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED){ throw std::bad_alloc(); }
+#if defined(MADV_HUGEPAGE)
+        if(policy.m_page_size != PageSize::DEFAULT){
+            madvise(ptr, length, MADV_HUGEPAGE); // only a hint, ignore the errors
+        }
+#endif
+    }
+
+    set_numa_policy(ptr, length, policy);
+
+    return ptr;
+}
+
+void deallocate(void* ptr, uint64_t size, const AllocationPolicy& policy) noexcept {
+    if(ptr == nullptr) return;
+
+    if(policy.m_page_size == PageSize::DEFAULT && policy.m_numa_policy == NumaPolicy::DEFAULT){
+        free(ptr);
+    } else {
+        if(size == 0) size = 1;
+        munmap(ptr, mapping_size(size, policy));
+    }
+}
+
+ostream& operator<<(ostream& out, const PageSize& page_size){
+    switch(page_size){
+    case PageSize::DEFAULT: out << "default"; break;
+    case PageSize::TRANSPARENT: out << "transparent huge pages"; break;
+    case PageSize::HUGE_2MB: out << "huge pages 2 MB"; break;
+    case PageSize::HUGE_1GB: out << "huge pages 1 GB"; break;
+    default: out << "unknown (" << static_cast<int>(page_size) << ")";
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const NumaPolicy& numa_policy){
+    switch(numa_policy){
+    case NumaPolicy::DEFAULT: out << "default"; break;
+    case NumaPolicy::INTERLEAVE: out << "interleave"; break;
+    case NumaPolicy::BIND: out << "bind"; break;
+    default: out << "unknown (" << static_cast<int>(numa_policy) << ")";
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const AllocationPolicy& policy){
+    out << "page size: " << policy.m_page_size << ", numa: " << policy.m_numa_policy;
+    if(policy.m_numa_policy == NumaPolicy::BIND){
+        out << " (node: " << policy.m_numa_node << ")";
+    }
+    return out;
+}
+
+} // namespace common::memory
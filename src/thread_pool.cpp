@@ -0,0 +1,166 @@
+/**
+ * This file is part of libcommon.
+ *
+ * libcommon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, orF
+ * (at your option) any later version.
+ *
+ * libcommon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libcommon.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace common {
+
+// The pool and the queue owned by the current thread, if it is a worker
+static thread_local ThreadPool* g_current_pool = nullptr;
+static thread_local uint64_t g_current_queue = 0;
+
+/*****************************************************************************
+ *                                                                           *
+ *   ThreadPool                                                              *
+ *                                                                           *
+ *****************************************************************************/
+
+ThreadPool::ThreadPool(uint64_t num_threads) : m_num_pending(0), m_num_idle(0), m_next_queue(0), m_terminate(false) {
+    for(uint64_t i = 0, num_queues = std::max<uint64_t>(num_threads, 1); i < num_queues; i++){ // with no workers, still a queue for the submitted tasks
+        m_queues.emplace_back(new Queue());
+    }
+    for(uint64_t i = 0; i < num_threads; i++){
+        m_workers.emplace_back(&ThreadPool::worker_main, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        lock_guard<mutex> lock(m_idle_mutex);
+        m_terminate = true;
+    }
+    m_idle_condvar.notify_all();
+    for(auto& worker : m_workers){ worker.join(); }
+}
+
+void ThreadPool::worker_main(uint64_t worker_id){
+    g_current_pool = this;
+    g_current_queue = worker_id;
+
+    Task task;
+    while(!m_terminate){
+        if(find_task(worker_id, task)){
+            task();
+            task = nullptr; // release the captured state
+        } else { // sleep until a new task is submitted
+            unique_lock<mutex> lock(m_idle_mutex);
+            m_num_idle++;
+            m_idle_condvar.wait(lock, [this](){ return m_num_pending > 0 || m_terminate; });
+            m_num_idle--;
+        }
+    }
+
+    g_current_pool = nullptr;
+}
+
+bool ThreadPool::pop_task(uint64_t queue_id, bool from_back, Task& task){
+    Queue* queue = m_queues[queue_id].get();
+    lock_guard<mutex> lock(queue->m_mutex);
+    if(queue->m_tasks.empty()) return false;
+    if(from_back){
+        task = std::move(queue->m_tasks.back());
+        queue->m_tasks.pop_back();
+    } else {
+        task = std::move(queue->m_tasks.front());
+        queue->m_tasks.pop_front();
+    }
+    m_num_pending--;
+    return true;
+}
+
+bool ThreadPool::find_task(uint64_t queue_id, Task& task){
+    const uint64_t num_queues = m_queues.size();
+    if(m_num_pending == 0) return false;
+    if(pop_task(queue_id, /* from back */ true, task)) return true;
+    for(uint64_t i = 1; i < num_queues; i++){ // steal
+        if(pop_task((queue_id + i) % num_queues, /* from back */ false, task)) return true;
+    }
+    return false;
+}
+
+void ThreadPool::submit(Task task){
+    uint64_t queue_id = (g_current_pool == this) ? g_current_queue : (m_next_queue++ % m_queues.size());
+    Queue* queue = m_queues[queue_id].get();
+    {
+        lock_guard<mutex> lock(queue->m_mutex);
+        queue->m_tasks.push_back(std::move(task));
+    }
+    m_num_pending++;
+
+    if(m_num_idle > 0){
+        { lock_guard<mutex> lock(m_idle_mutex); } // the worker is either before the check of the predicate or already waiting
+        m_idle_condvar.notify_one();
+    }
+}
+
+bool ThreadPool::execute_pending_task(){
+    Task task;
+    uint64_t queue_id = (g_current_pool == this) ? g_current_queue : 0;
+    if(!find_task(queue_id, task)) return false;
+    task();
+    return true;
+}
+
+uint64_t ThreadPool::num_threads() const noexcept {
+    return m_workers.size();
+}
+
+ThreadPool& ThreadPool::global(){
+    static ThreadPool pool { std::max<uint64_t>(1, thread::hardware_concurrency()) };
+    return pool;
+}
+
+/*****************************************************************************
+ *                                                                           *
+ *   TaskGroup                                                               *
+ *                                                                           *
+ *****************************************************************************/
+
+TaskGroup::TaskGroup(ThreadPool& pool) : m_pool(pool), m_num_active(0) {
+
+}
+
+TaskGroup::~TaskGroup(){
+    try {
+        wait();
+    } catch(...) { /* ignore */ }
+}
+
+void TaskGroup::wait(){
+    while(m_num_active > 0){
+        if(!m_pool.execute_pending_task()){
+            this_thread::yield();
+        }
+    }
+
+    exception_ptr exception;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        std::swap(exception, m_exception);
+    }
+    if(exception){ std::rethrow_exception(exception); }
+}
+
+ThreadPool& TaskGroup::pool() noexcept {
+    return m_pool;
+}
+
+} // namespace common
@@ -0,0 +1,493 @@
+#include "gtest/gtest.h"
+
+#include <cinttypes>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lib/common/circular_array.hpp"
+#include "lib/common/concurrent_circular_array.hpp"
+#include "lib/common/spinlock.hpp"
+#include "lib/common/timer.hpp"
+
+using namespace std;
+using namespace common;
+
+TEST(CircularArray, non_trivial){
+    CircularArray<string> queue(/* capacity */ 2);
+    for(int i = 0; i < 100; i++){
+        if(i % 2 == 0)
+            queue.append("item_" + to_string(i));
+        else
+            queue.emplace_front(5, 'a' + (i % 26));
+    }
+    ASSERT_EQ(queue.size(), 100);
+    ASSERT_EQ(queue[0], string(5, 'a' + (99 % 26)));
+    ASSERT_EQ(queue[99], "item_98");
+
+    queue.remove([](const string& s){ return s.size() == 5; }); // only the first
+    ASSERT_EQ(queue.size(), 99);
+    auto is_short = [](const string& s){ return s.size() == 5; };
+    queue.remove<decltype(is_short), true>(is_short); // all
+    ASSERT_EQ(queue.size(), 50);
+    for(int i = 0; i < 50; i++){
+        ASSERT_EQ(queue.pop(), "item_" + to_string(i * 2));
+    }
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(CircularArray, move_only){
+    CircularArray<unique_ptr<int>> queue(/* capacity */ 4);
+    for(int i = 0; i < 10; i++){ queue.emplace_back(new int(i)); }
+    queue.prepend(make_unique<int>(-1));
+    ASSERT_EQ(*queue[0], -1);
+
+    CircularArray<unique_ptr<int>> other { std::move(queue) };
+    ASSERT_EQ(other.size(), 11);
+    ASSERT_TRUE(queue.empty());
+    queue.append(make_unique<int>(42)); // a moved-from container is still usable
+    ASSERT_EQ(*queue.pop(), 42);
+
+    for(int i = -1; i < 10; i++){
+        unique_ptr<int> item = other.pop();
+        ASSERT_EQ(*item, i);
+    }
+    ASSERT_TRUE(other.empty());
+    ASSERT_THROW(other.pop(), std::runtime_error);
+}
+
+TEST(CircularArray, power_of_two){
+    CircularArray<int64_t, std::allocator<int64_t>, /* power of two */ true> queue(/* capacity */ 5); // rounded to 8
+    ASSERT_EQ(queue.capacity(), 8);
+
+    // the counters go below zero with prepend
+    for(int64_t i = 0; i < 6; i++){ queue.prepend(-i); }
+    for(int64_t i = 1; i <= 2; i++){ queue.append(i); }
+    ASSERT_EQ(queue.size(), 8);
+    ASSERT_EQ(queue.capacity(), 8);
+    for(int64_t i = 0; i < 8; i++){
+        ASSERT_EQ(queue[i], i -5);
+        ASSERT_EQ(queue.at_unchecked(i), i -5);
+    }
+    ASSERT_EQ(queue.front(), -5);
+    ASSERT_EQ(queue.back(), 2);
+    ASSERT_THROW(queue[8], std::runtime_error);
+    ASSERT_THROW(queue[-1], std::runtime_error);
+
+    queue.append(3); // resize
+    ASSERT_EQ(queue.capacity(), 16);
+    for(int64_t i = 0; i < 9; i++){ ASSERT_EQ(queue[i], i -5); }
+
+    queue.clear(20);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.capacity(), 32);
+}
+
+// By default, the capacity is exactly the one requested
+TEST(CircularArray, exact_capacity){
+    CircularArray<int64_t> queue(/* capacity */ 5);
+    ASSERT_EQ(queue.capacity(), 5);
+    ASSERT_EQ((CircularArray<int64_t>(100).capacity()), 100);
+
+    // wrap around the end of the array, in both directions
+    for(int64_t round = 0; round < 3; round++){
+        for(int64_t i = 0; i < 3; i++){ queue.prepend(-i); }
+        for(int64_t i = 1; i <= 2; i++){ queue.append(i); }
+        ASSERT_EQ(queue.size(), 5);
+        ASSERT_EQ(queue.capacity(), 5);
+        for(int64_t i = 0; i < 5; i++){
+            ASSERT_EQ(queue[i], i -2);
+            ASSERT_EQ(queue.at_unchecked(i), i -2);
+        }
+        ASSERT_EQ(queue.front(), -2);
+        ASSERT_EQ(queue.back(), 2);
+        ASSERT_THROW(queue[5], std::runtime_error);
+        for(int64_t i = 0; i < 4; i++){ ASSERT_EQ(queue.pop(), i -2); }
+        ASSERT_EQ(queue.pop(), 2);
+        ASSERT_TRUE(queue.empty());
+    }
+
+    for(int64_t i = 0; i < 6; i++){ queue.append(i); } // resize
+    ASSERT_EQ(queue.capacity(), 10);
+    for(int64_t i = 0; i < 6; i++){ ASSERT_EQ(queue[i], i); }
+
+    queue.clear(20);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.capacity(), 20);
+    queue.append(1);
+    queue.shrink_to_fit();
+    ASSERT_EQ(queue.capacity(), 1);
+}
+
+TEST(CircularArray, bulk){
+    CircularArray<uint64_t> queue(/* capacity */ 8);
+    uint64_t batch[20];
+    for(uint64_t i = 0; i < 20; i++){ batch[i] = i; }
+
+    queue.append_bulk(batch, 6);
+    ASSERT_EQ(queue.pop(), 0);
+    ASSERT_EQ(queue.pop(), 1);
+    ASSERT_EQ(queue.pop(), 2);
+    queue.append_bulk(batch + 6, 4); // wraps around the end of the array
+    ASSERT_EQ(queue.capacity(), 8);
+    ASSERT_EQ(queue.size(), 7);
+
+    auto spans = queue.spans();
+    ASSERT_EQ(spans.first.size(), 5); // positions 3 - 7
+    ASSERT_EQ(spans.second.size(), 2); // positions 0 - 1
+    uint64_t expected = 3;
+    for(auto v : spans.first){ ASSERT_EQ(v, expected++); }
+    for(auto v : spans.second){ ASSERT_EQ(v, expected++); }
+
+    uint64_t out[20];
+    ASSERT_EQ(queue.pop_bulk(out, 6), 6);
+    for(uint64_t i = 0; i < 6; i++){ ASSERT_EQ(out[i], i + 3); }
+    ASSERT_EQ(queue.size(), 1);
+
+    queue.append_bulk(batch, 20); // resize
+    ASSERT_EQ(queue.capacity(), 21); // max(2 * capacity, size + 20)
+    ASSERT_TRUE(queue.spans().second.empty());
+    queue.discard(1);
+    ASSERT_EQ(queue.pop_bulk(out, 64), 20);
+    for(uint64_t i = 0; i < 20; i++){ ASSERT_EQ(out[i], i); }
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.pop_bulk(out, 64), 0);
+}
+
+TEST(CircularArray, bulk_non_trivial){
+    CircularArray<string> queue(/* capacity */ 4);
+    string batch[] = { "a", "b", "c", "d", "e" };
+    queue.append("z");
+    queue.append_bulk(batch, 5);
+    queue.discard(2);
+    string out[8];
+    ASSERT_EQ(queue.pop_bulk(out, 8), 4);
+    ASSERT_EQ(out[0], "b");
+    ASSERT_EQ(out[3], "e");
+    ASSERT_EQ(batch[0], "a"); // the source is copied, not moved
+    ASSERT_THROW(queue.discard(1), std::runtime_error);
+}
+
+TEST(CircularArray, shrink){
+    CircularArray<uint64_t> queue(/* capacity */ 4);
+    for(uint64_t i = 0; i < 1000; i++){ queue.append(i); }
+    ASSERT_EQ(queue.capacity(), 1024);
+
+    // hysteresis: shrink only when the array is a quarter full
+    uint64_t out[1000];
+    ASSERT_EQ(queue.pop_bulk(out, 700), 700);
+    ASSERT_EQ(queue.capacity(), 1024);
+    ASSERT_EQ(queue.pop_bulk(out, 44), 44); // 256 elements left
+    ASSERT_EQ(queue.capacity(), 512);
+    for(uint64_t i = 0; i < 256; i++){
+        ASSERT_EQ(queue.pop(), 744 + i);
+    }
+    ASSERT_EQ(queue.capacity(), 4); // never below the min capacity
+
+    // shrink_to_fit ignores the min capacity
+    queue.append(1);
+    queue.shrink_to_fit();
+    ASSERT_EQ(queue.capacity(), 1);
+    ASSERT_EQ(queue[0], 1);
+
+    // never shrink
+    queue.set_min_capacity(numeric_limits<uint64_t>::max());
+    for(uint64_t i = 0; i < 100; i++){ queue.append(i); }
+    ASSERT_EQ(queue.pop_bulk(out, 1000), 101);
+    ASSERT_EQ(queue.capacity(), 128);
+}
+
+namespace {
+// Count the bytes currently allocated through it
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+    int64_t* m_allocated;
+
+    CountingAllocator(int64_t* allocated) : m_allocated(allocated) { }
+    template<typename U> CountingAllocator(const CountingAllocator<U>& other) : m_allocated(other.m_allocated) { }
+
+    T* allocate(size_t n){ *m_allocated += n * sizeof(T); return std::allocator<T>{}.allocate(n); }
+    void deallocate(T* ptr, size_t n){ *m_allocated -= n * sizeof(T); std::allocator<T>{}.deallocate(ptr, n); }
+
+    template<typename U> bool operator==(const CountingAllocator<U>& other) const { return m_allocated == other.m_allocated; }
+    template<typename U> bool operator!=(const CountingAllocator<U>& other) const { return m_allocated != other.m_allocated; }
+};
+} // anonymous namespace
+
+TEST(CircularArray, allocator){
+    int64_t allocated = 0;
+    {
+        CircularArray<string, CountingAllocator<string>> queue(/* capacity */ 8, CountingAllocator<string>(&allocated));
+        ASSERT_EQ(allocated, 8 * sizeof(string));
+        for(int i = 0; i < 64; i++){ queue.emplace_back(to_string(i)); }
+        ASSERT_EQ(allocated, 64 * sizeof(string));
+        queue.remove([](const string& s){ return s == "10"; });
+        ASSERT_EQ(allocated, 64 * sizeof(string)); // in place
+        ASSERT_EQ(queue.size(), 63);
+        while(queue.size() > 1) queue.pop();
+        ASSERT_EQ(allocated, 8 * sizeof(string));
+        ASSERT_EQ(queue.get_allocator().m_allocated, &allocated);
+
+        CircularArray<string, CountingAllocator<string>> other { std::move(queue) };
+        ASSERT_EQ(other[0], "63");
+        ASSERT_EQ(allocated, 8 * sizeof(string));
+    }
+    ASSERT_EQ(allocated, 0);
+}
+
+// Track the number of live instances, to check every element constructed is destroyed once
+namespace {
+struct Tracked {
+    static int64_t s_live;
+    int64_t m_value;
+    Tracked(int64_t value) : m_value(value) { s_live++; }
+    Tracked(const Tracked& other) : m_value(other.m_value) { s_live++; }
+    Tracked(Tracked&& other) : m_value(other.m_value) { s_live++; }
+    Tracked& operator=(const Tracked& other) = default;
+    Tracked& operator=(Tracked&& other) = default;
+    ~Tracked(){ s_live--; }
+};
+int64_t Tracked::s_live = 0;
+} // anonymous namespace
+
+TEST(CircularArray, lifetime){
+    {
+        CircularArray<Tracked> queue(/* capacity */ 3);
+        ASSERT_EQ(Tracked::s_live, 0); // the storage is not initialised
+        for(int64_t i = 0; i < 20; i++){ queue.emplace_back(i); }
+        ASSERT_EQ(Tracked::s_live, 20);
+        for(int64_t i = 0; i < 5; i++){ ASSERT_EQ(queue.pop().m_value, i); }
+        ASSERT_EQ(Tracked::s_live, 15);
+        auto multiple_of_3 = [](const Tracked& t){ return t.m_value % 3 == 0; };
+        queue.remove<decltype(multiple_of_3), true>(multiple_of_3);
+        ASSERT_EQ(queue.size(), 10);
+        ASSERT_EQ(Tracked::s_live, 10);
+        queue.clear();
+        ASSERT_EQ(Tracked::s_live, 0);
+        for(int64_t i = 0; i < 7; i++){ queue.emplace_front(i); }
+        ASSERT_EQ(Tracked::s_live, 7);
+    }
+    ASSERT_EQ(Tracked::s_live, 0);
+}
+
+// Cost of a random access, checked (operator[]) and unchecked (at_unchecked), over a queue that wraps around the end of the array
+template<bool PowerOfTwo>
+static void benchmark_access(const char* name, uint64_t capacity){
+    constexpr uint64_t num_accesses = 100000000;
+    CircularArray<uint64_t, std::allocator<uint64_t>, PowerOfTwo> queue(capacity);
+    for(uint64_t i = 0; i < capacity / 2; i++){ queue.append(0); queue.pop(); } // move the start in the middle of the array
+    for(uint64_t i = 0; i < capacity; i++){ queue.append(i); }
+    const uint64_t mask = capacity -1; // the positions accessed, the capacity of the tests is a power of 2
+
+    Timer<true> timer_checked;
+    timer_checked.start();
+    uint64_t sum_checked = 0;
+    for(uint64_t i = 0; i < num_accesses; i++){ sum_checked += queue[(i * 7) & mask]; }
+    timer_checked.stop();
+
+    Timer<true> timer_unchecked;
+    timer_unchecked.start();
+    uint64_t sum_unchecked = 0;
+    for(uint64_t i = 0; i < num_accesses; i++){ sum_unchecked += queue.at_unchecked((i * 7) & mask); }
+    timer_unchecked.stop();
+    ASSERT_EQ(sum_checked, sum_unchecked);
+
+    auto ns = [](const Timer<true>& timer){ return static_cast<double>(timer.nanoseconds()) / num_accesses; };
+    cout << "[" << name << ", capacity: " << capacity << "] operator[]: " << ns(timer_checked) << " ns, at_unchecked: " << ns(timer_unchecked) << " ns" << endl;
+}
+
+// Not executed by default, run with --gtest_also_run_disabled_tests --gtest_filter='CircularArray.DISABLED_benchmark*'
+TEST(CircularArray, DISABLED_benchmark_access){
+    for(uint64_t capacity : {1ull << 10, 1ull << 20}){
+        benchmark_access</* power of two */ false>("exact capacity", capacity);
+        benchmark_access</* power of two */ true>("power of two", capacity);
+    }
+}
+
+template<QueueMode Mode>
+static void check_sequential(){
+    ConcurrentCircularArray<uint64_t, Mode> queue(/* capacity */ 6); // rounded to 8
+    ASSERT_EQ(queue.capacity(), 8);
+    ASSERT_TRUE(queue.empty());
+
+    uint64_t value = 0;
+    ASSERT_FALSE(queue.pop(value));
+    for(uint64_t i = 0; i < 8; i++){ ASSERT_TRUE(queue.append(i)); }
+    ASSERT_FALSE(queue.append(8)); // full
+    ASSERT_EQ(queue.size(), 8);
+
+    for(uint64_t i = 0; i < 5; i++){
+        ASSERT_TRUE(queue.pop(value));
+        ASSERT_EQ(value, i);
+    }
+
+    // batches wrapping around the end of the array
+    uint64_t batch[] = {8, 9, 10, 11, 12, 13, 14};
+    ASSERT_EQ(queue.append_bulk(batch, 7), 5);
+    ASSERT_EQ(queue.size(), 8);
+    uint64_t out[16];
+    ASSERT_EQ(queue.pop_bulk(out, 16), 8);
+    for(uint64_t i = 0; i < 8; i++){ ASSERT_EQ(out[i], i + 5); }
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.pop_bulk(out, 16), 0);
+}
+
+TEST(ConcurrentCircularArray, spsc_sequential){
+    check_sequential<QueueMode::SPSC>();
+}
+
+TEST(ConcurrentCircularArray, mpsc_sequential){
+    check_sequential<QueueMode::MPSC>();
+}
+
+TEST(ConcurrentCircularArray, spsc){
+    constexpr uint64_t num_items = 1000000;
+    ConcurrentCircularArray<uint64_t, QueueMode::SPSC> queue(/* capacity */ 256);
+
+    thread producer([&](){
+        uint64_t batch[7];
+        uint64_t next = 0;
+        while(next < num_items){
+            uint64_t count = 0;
+            if(next % 2 == 0){ // single
+                count = queue.append(next) ? 1 : 0;
+            } else { // batch
+                uint64_t batch_sz = std::min<uint64_t>(7, num_items - next);
+                for(uint64_t i = 0; i < batch_sz; i++){ batch[i] = next + i; }
+                count = queue.append_bulk(batch, batch_sz);
+            }
+            if(count == 0) this_thread::yield(); // full
+            next += count;
+        }
+    });
+
+    uint64_t expected = 0;
+    uint64_t out[13];
+    while(expected < num_items){
+        uint64_t count = queue.pop_bulk(out, 13);
+        if(count == 0) this_thread::yield(); // empty
+        for(uint64_t i = 0; i < count; i++){
+            ASSERT_EQ(out[i], expected);
+            expected++;
+        }
+    }
+    producer.join();
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(ConcurrentCircularArray, mpsc){
+    constexpr uint64_t num_producers = 4;
+    constexpr uint64_t num_items = 200000; // per producer
+    ConcurrentCircularArray<uint64_t, QueueMode::MPSC> queue(/* capacity */ 64);
+
+    vector<thread> producers;
+    for(uint64_t producer_id = 0; producer_id < num_producers; producer_id++){
+        producers.emplace_back([&, producer_id](){
+            uint64_t batch[5];
+            uint64_t next = 0;
+            while(next < num_items){
+                // the producer id in the high bits, the sequence in the low bits
+                uint64_t batch_sz = std::min<uint64_t>(1 + next % 5, num_items - next);
+                for(uint64_t i = 0; i < batch_sz; i++){ batch[i] = (producer_id << 32) | (next + i); }
+                uint64_t count = queue.append_bulk(batch, batch_sz);
+                if(count == 0) this_thread::yield(); // full
+                next += count;
+            }
+        });
+    }
+
+    // the items of the same producer are received in order
+    vector<uint64_t> expected(num_producers, 0);
+    uint64_t num_received = 0;
+    uint64_t out[16];
+    while(num_received < num_producers * num_items){
+        uint64_t count = queue.pop_bulk(out, 16);
+        if(count == 0) this_thread::yield(); // empty
+        for(uint64_t i = 0; i < count; i++){
+            uint64_t producer_id = out[i] >> 32;
+            ASSERT_LT(producer_id, num_producers);
+            ASSERT_EQ(out[i] & 0xFFFFFFFF, expected[producer_id]);
+            expected[producer_id]++;
+        }
+        num_received += count;
+    }
+    for(auto& t : producers){ t.join(); }
+    ASSERT_TRUE(queue.empty());
+}
+
+// A CircularArray protected by a SpinLock, bounded to the same capacity of the concurrent queue, as the baseline of the benchmark
+class LockedCircularArray {
+    SpinLock m_lock;
+    CircularArray<uint64_t> m_queue;
+    const uint64_t m_capacity;
+
+public:
+    LockedCircularArray(uint64_t capacity) : m_queue(capacity), m_capacity(capacity) { }
+
+    uint64_t append_bulk(const uint64_t* items, uint64_t num_items){
+        lock_guard<SpinLock> lock(m_lock);
+        uint64_t count = min<uint64_t>(num_items, m_capacity - m_queue.size());
+        m_queue.append_bulk(items, count);
+        return count;
+    }
+
+    uint64_t pop_bulk(uint64_t* items, uint64_t num_items){
+        lock_guard<SpinLock> lock(m_lock);
+        return m_queue.pop_bulk(items, num_items);
+    }
+};
+
+// Throughput of `num_producers' threads sending items, in batches, to a single consumer
+template<typename Queue>
+static void benchmark_queue(const char* name, uint64_t num_producers, uint64_t batch_sz){
+    constexpr uint64_t capacity = 1024, num_items = 4000000;
+    Queue queue(capacity);
+    const uint64_t items_per_producer = num_items / num_producers;
+
+    Timer<true> timer;
+    timer.start();
+    vector<thread> producers;
+    for(uint64_t producer_id = 0; producer_id < num_producers; producer_id++){
+        producers.emplace_back([&queue, producer_id, batch_sz, items_per_producer](){
+            vector<uint64_t> batch(batch_sz, producer_id +1);
+            uint64_t num_sent = 0;
+            while(num_sent < items_per_producer){
+                uint64_t count = queue.append_bulk(batch.data(), min(batch_sz, items_per_producer - num_sent));
+                num_sent += count;
+                if(count == 0) this_thread::yield(); // full
+            }
+        });
+    }
+
+    // consumer
+    vector<uint64_t> batch(batch_sz);
+    uint64_t num_received = 0, sum = 0;
+    while(num_received < items_per_producer * num_producers){
+        uint64_t count = queue.pop_bulk(batch.data(), batch_sz);
+        for(uint64_t i = 0; i < count; i++){ sum += batch[i]; }
+        num_received += count;
+        if(count == 0) this_thread::yield(); // empty
+    }
+    for(auto& t : producers){ t.join(); }
+    timer.stop();
+    ASSERT_EQ(sum, items_per_producer * num_producers * (num_producers +1) / 2);
+
+    cout << "[" << name << ", producers: " << num_producers << ", batch size: " << batch_sz << "] " <<
+            static_cast<double>(num_received) / timer.microseconds() << " Mops" << endl;
+}
+
+// Not executed by default, run with --gtest_also_run_disabled_tests --gtest_filter='ConcurrentCircularArray.DISABLED_benchmark*'
+TEST(ConcurrentCircularArray, DISABLED_benchmark_throughput){
+    for(uint64_t batch_sz : {1, 64}){
+        benchmark_queue<ConcurrentCircularArray<uint64_t, QueueMode::SPSC>>("SPSC", 1, batch_sz);
+        benchmark_queue<LockedCircularArray>("CircularArray + SpinLock", 1, batch_sz);
+        for(uint64_t num_producers : {2, 4}){
+            benchmark_queue<ConcurrentCircularArray<uint64_t, QueueMode::MPSC>>("MPSC", num_producers, batch_sz);
+            benchmark_queue<LockedCircularArray>("CircularArray + SpinLock", num_producers, batch_sz);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "lib/common/external_sort.hpp"
+
+using namespace std;
+using namespace common;
+
+// The directory for the files of the tests, as chosen by the implementation: $TMPDIR, or /tmp otherwise
+static string temporary_directory(){
+    const char* tmpdir = getenv("TMPDIR");
+    return (tmpdir != nullptr && tmpdir[0] != '\0') ? string(tmpdir) : string("/tmp");
+}
+
+// The path of a file for the tests, in the temporary directory
+static string test_path(const string& suffix){
+    return temporary_directory() + "/libcommon_test_external_sort_" + to_string(getpid()) + suffix;
+}
+
+template<typename T>
+static void write_file(const string& path, const vector<T>& elements){
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(elements.data()), elements.size() * sizeof(T));
+}
+
+template<typename T>
+static vector<T> read_file(const string& path){
+    ifstream in(path, ios::binary | ios::ate);
+    vector<T> elements(static_cast<uint64_t>(in.tellg()) / sizeof(T));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(elements.data()), elements.size() * sizeof(T));
+    return elements;
+}
+
+TEST(ExternalSort, sanity){
+    const string path_input = test_path(".in");
+    const string path_output = test_path(".out");
+
+    for(uint64_t num_elements : {0, 1, 1000, 300000}){
+        vector<uint64_t> elements(num_elements);
+        mt19937_64 random_generator{num_elements};
+        for(auto& e : elements){ e = random_generator(); }
+        write_file(path_input, elements);
+        std::sort(elements.begin(), elements.end());
+
+        external_sort<uint64_t>(path_input, path_output, ComputerQuantity("256k", true)); // runs of 16k elements, i.e. 19 runs for 300000 elements
+        ASSERT_EQ(read_file<uint64_t>(path_output), elements);
+    }
+
+    remove(path_input.c_str());
+    remove(path_output.c_str());
+}
+
+TEST(ExternalSort, in_place){
+    const string path = test_path(".dat");
+
+    vector<double> elements(100000);
+    mt19937_64 random_generator{1};
+    for(auto& e : elements){ e = static_cast<double>(random_generator() % 1000) / 7; }
+    write_file(path, elements);
+    std::sort(elements.begin(), elements.end(), std::greater<double>());
+
+    external_sort<double>(path, path, ComputerQuantity("128k", true), std::greater<double>(), /* temporary directory */ temporary_directory());
+    ASSERT_EQ(read_file<double>(path), elements);
+
+    remove(path.c_str());
+}
+
+TEST(ExternalSort, invalid_input){
+    const string path = test_path(".dat");
+    write_file<char>(path, vector<char>(13, 'x')); // not a multiple of 8 bytes
+    ASSERT_THROW(external_sort<uint64_t>(path, path, ComputerQuantity("1M", true)), common::Error);
+    remove(path.c_str());
+    ASSERT_THROW(external_sort<uint64_t>(path, path, ComputerQuantity("1M", true)), common::Error); // not existing
+}
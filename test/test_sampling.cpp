@@ -0,0 +1,275 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lib/common/sampling.hpp"
+
+using namespace std;
+using namespace common;
+
+// The samples are distinct and in the order of their position in the input
+static void validate(const vector<uint64_t>& input, const vector<uint64_t>& output, uint64_t num_samples){
+    for(uint64_t i = 0; i < num_samples; i++){
+        ASSERT_LT(output[i], input.size());
+        if(i > 0){ ASSERT_LT(output[i -1], output[i]); }
+    }
+}
+
+TEST(Sampling, sanity){
+    vector<uint64_t> input(10000);
+    iota(begin(input), end(input), 0);
+    for(uint64_t expected : {0, 1, 7, 100, 1000, 5000, 10000, 20000}){
+        vector<uint64_t> output(input.size());
+        uint64_t num_samples = expected;
+        random_sample(input.data(), input.size(), output.data(), num_samples, /* seed */ 42);
+        ASSERT_EQ(num_samples, min<uint64_t>(expected, input.size()));
+        validate(input, output, num_samples);
+    }
+}
+
+// Multiple chunks, sampled in parallel
+TEST(Sampling, parallel){
+    vector<uint64_t> input(5 * details::sampling::chunk_sz + 123);
+    iota(begin(input), end(input), 0);
+    uint64_t num_samples = input.size() / 10;
+    vector<uint64_t> output1(num_samples), output2(num_samples);
+    random_sample(input.data(), input.size(), output1.data(), num_samples, /* seed */ 7);
+    ASSERT_EQ(num_samples, input.size() / 10);
+    validate(input, output1, num_samples);
+
+    // deterministic for the same seed
+    random_sample(input.data(), input.size(), output2.data(), num_samples, /* seed */ 7);
+    ASSERT_EQ(output1, output2);
+
+    // the samples are spread over all chunks
+    vector<uint64_t> count(6);
+    for(uint64_t value : output1) count[value / details::sampling::chunk_sz]++;
+    for(uint64_t chunk_id = 0; chunk_id < 5; chunk_id++){
+        ASSERT_NEAR(count[chunk_id], details::sampling::chunk_sz / 10, 2000);
+    }
+}
+
+TEST(Sampling, hypergeometric){
+    details::sampling::RandomGenerator rnd { 1 };
+    const uint64_t num_draws = 10000;
+    double sum = 0;
+    for(uint64_t i = 0; i < num_draws; i++){
+        uint64_t k = details::sampling::hypergeometric(rnd, 1000, 3000, 10000);
+        ASSERT_LE(k, 1000);
+        sum += k;
+    }
+    ASSERT_NEAR(sum / num_draws, 300, 2); // expected value: 1000 * 3000 / 10000
+
+    // degenerate cases
+    ASSERT_EQ(details::sampling::hypergeometric(rnd, 10, 100, 100), 10);
+    ASSERT_EQ(details::sampling::hypergeometric(rnd, 100, 50, 100), 50);
+    ASSERT_EQ(details::sampling::hypergeometric(rnd, 0, 50, 100), 0);
+}
+
+TEST(Sampling, reservoir){
+    ReservoirSampler<uint64_t> sampler { 100, /* seed */ 1 };
+    ASSERT_EQ(sampler.capacity(), 100);
+    ASSERT_EQ(sampler.size(), 0);
+
+    // fewer elements than the capacity, they are all retained
+    for(uint64_t i = 0; i < 50; i++){ sampler.offer(i); }
+    ASSERT_EQ(sampler.size(), 50);
+    for(uint64_t i = 0; i < 50; i++){ ASSERT_EQ(sampler.samples()[i], i); }
+
+    vector<uint64_t> input(1000000);
+    iota(begin(input), end(input), 50);
+    sampler.offer(input.data(), input.size());
+    ASSERT_EQ(sampler.size(), 100);
+    ASSERT_EQ(sampler.num_seen(), 1000050);
+    vector<uint64_t> samples = sampler.samples();
+    sort(begin(samples), end(samples));
+    ASSERT_TRUE(adjacent_find(begin(samples), end(samples)) == end(samples)); // distinct
+    ASSERT_LT(samples.back(), 1000050);
+
+    // batches or single elements, the result is the same
+    ReservoirSampler<uint64_t> s1 { 10, /* seed */ 3 }, s2 { 10, /* seed */ 3 };
+    s1.offer(input.data(), input.size());
+    for(uint64_t i = 0; i < 1000; i++){ s2.offer(input.data() + i * 1000, 1000); }
+    ASSERT_EQ(s1.samples(), s2.samples());
+}
+
+// Each element should be retained with probability k / N
+TEST(Sampling, reservoir_uniform){
+    constexpr uint64_t num_elements = 100, capacity = 10, num_trials = 20000;
+    vector<uint64_t> input(num_elements);
+    iota(begin(input), end(input), 0);
+    vector<uint64_t> count(num_elements), count_merge(num_elements);
+    for(uint64_t trial = 0; trial < num_trials; trial++){
+        ReservoirSampler<uint64_t> sampler { capacity, trial };
+        sampler.offer(input.data(), input.size());
+        for(uint64_t value : sampler.samples()) count[value]++;
+
+        // two streams of different lengths
+        ReservoirSampler<uint64_t> s1 { capacity, trial }, s2 { capacity, trial + num_trials };
+        s1.offer(input.data(), 30);
+        s2.offer(input.data() + 30, 70);
+        s1.merge(s2);
+        ASSERT_EQ(s1.size(), capacity);
+        ASSERT_EQ(s1.num_seen(), num_elements);
+        for(uint64_t value : s1.samples()) count_merge[value]++;
+    }
+
+    const double expected = static_cast<double>(num_trials) * capacity / num_elements; // 2000
+    for(uint64_t i = 0; i < num_elements; i++){
+        ASSERT_NEAR(count[i], expected, 250);
+        ASSERT_NEAR(count_merge[i], expected, 250);
+    }
+}
+
+// Offer more elements after a merge
+TEST(Sampling, reservoir_merge){
+    ReservoirSampler<uint64_t> s1 { 5, /* seed */ 1 }, s2 { 5, /* seed */ 2 };
+    s1.offer(1); s1.offer(2);
+    s2.offer(3);
+    s1.merge(s2);
+    ASSERT_EQ(s1.size(), 3);
+    vector<uint64_t> merged = s1.samples();
+    sort(begin(merged), end(merged));
+    ASSERT_EQ(merged, (vector<uint64_t>{ 1, 2, 3 }));
+    vector<uint64_t> input(1000);
+    iota(begin(input), end(input), 4);
+    s1.offer(input.data(), input.size());
+    ASSERT_EQ(s1.size(), 5);
+    ASSERT_EQ(s1.num_seen(), 1003);
+
+    ReservoirSampler<uint64_t> s3 { 6 };
+    ASSERT_THROW(s1.merge(s3), std::invalid_argument);
+}
+
+// Batches smaller than the capacity are appended as they are
+TEST(Sampling, reservoir_partial){
+    vector<uint64_t> input { 26, 27, 28, 29, 30, 31, 32, 33, 34, 35 };
+    ReservoirSampler<uint64_t> sampler { 10, /* seed */ 0 };
+    sampler.offer(input.data(), 4);
+    ASSERT_EQ(sampler.samples(), (vector<uint64_t>{ 26, 27, 28, 29 }));
+    sampler.offer(input.data() + 4, 6);
+    ASSERT_EQ(sampler.samples(), input);
+
+    ReservoirSampler<string> strings { 100 };
+    strings.offer("a");
+    strings.offer("b");
+    ASSERT_EQ(strings.samples(), (vector<string>{ "a", "b" }));
+}
+
+// Merge a reservoir not full yet with a full reservoir, each element should be retained with probability k / N
+TEST(Sampling, reservoir_merge_partial){
+    constexpr uint64_t num_elements = 30, capacity = 10, num_trials = 30000;
+    vector<uint64_t> input(num_elements);
+    iota(begin(input), end(input), 0);
+    vector<uint64_t> count(num_elements);
+    for(uint64_t trial = 0; trial < num_trials; trial++){
+        ReservoirSampler<uint64_t> s1 { capacity, trial }, s2 { capacity, trial + num_trials };
+        s1.offer(input.data(), 4);
+        s2.offer(input.data() + 4, 26);
+        s1.merge(s2);
+        ASSERT_EQ(s1.size(), capacity);
+        vector<uint64_t> samples = s1.samples();
+        sort(begin(samples), end(samples));
+        ASSERT_TRUE(adjacent_find(begin(samples), end(samples)) == end(samples)); // distinct
+        for(uint64_t value : samples) count[value]++;
+    }
+
+    // chi-squared test, 29 degrees of freedom: the critical value at p = 0.001 is 58.3
+    const double expected = static_cast<double>(num_trials) * capacity / num_elements;
+    double chi2 = 0;
+    for(uint64_t i = 0; i < num_elements; i++){
+        chi2 += (count[i] - expected) * (count[i] - expected) / expected;
+    }
+    ASSERT_LT(chi2, 58.3);
+}
+
+TEST(Sampling, alias_table){
+    vector<double> weights { 1, 0, 2, 3, 4 }; // total 10
+    AliasTable table { weights.data(), weights.size() };
+    ASSERT_EQ(table.size(), 5);
+    constexpr uint64_t num_samples = 100000;
+    vector<uint64_t> output(num_samples);
+    table.sample(output.data(), num_samples, /* seed */ 1);
+    vector<uint64_t> count(weights.size());
+    for(uint64_t position : output) count[position]++;
+    ASSERT_EQ(count[1], 0);
+    for(uint64_t i = 0; i < weights.size(); i++){
+        ASSERT_NEAR(count[i], num_samples * weights[i] / 10, 1000);
+    }
+
+    // deterministic for the same seed
+    vector<uint64_t> output2(num_samples);
+    table.sample(output2.data(), num_samples, /* seed */ 1);
+    ASSERT_EQ(output, output2);
+
+    vector<double> invalid { 1, -1 };
+    ASSERT_THROW(AliasTable(invalid.data(), invalid.size()), std::invalid_argument);
+    vector<double> zeros { 0, 0 };
+    ASSERT_THROW(AliasTable(zeros.data(), zeros.size()), std::invalid_argument);
+}
+
+// Multiple blocks, e.g. biased by the degree of the vertices
+TEST(Sampling, alias_table_blocks){
+    const uint64_t num_weights = 3 * details::sampling::alias_block_sz + 10;
+    vector<uint64_t> degrees(num_weights);
+    for(uint64_t i = 0; i < num_weights; i++){ degrees[i] = (i % 4 == 0) ? 3 : 1; }
+    vector<uint64_t> vertices(num_weights);
+    iota(begin(vertices), end(vertices), 0);
+    constexpr uint64_t num_samples = 600000;
+    vector<uint64_t> output(num_samples);
+    weighted_random_sample_with_replacement(vertices.data(), degrees.data(), num_weights, output.data(), num_samples, /* seed */ 2);
+    uint64_t count_heavy = 0;
+    for(uint64_t vertex : output){
+        ASSERT_LT(vertex, num_weights);
+        count_heavy += (vertex % 4 == 0);
+    }
+    ASSERT_NEAR(count_heavy, num_samples / 2, 3000); // half of the total weight
+
+    mt19937_64 generator { 3 };
+    AliasTable table { degrees.data(), num_weights };
+    for(uint64_t i = 0; i < 1000; i++){ ASSERT_LT(table(generator), num_weights); }
+}
+
+TEST(Sampling, weighted_without_replacement){
+    vector<uint64_t> input { 0, 1, 2, 3 };
+    vector<double> weights { 1, 0, 1, 8 };
+    vector<uint64_t> output(4);
+
+    // zero weights are never selected
+    uint64_t num_samples = 4;
+    weighted_random_sample(input.data(), weights.data(), input.size(), output.data(), num_samples, /* seed */ 1);
+    ASSERT_EQ(num_samples, 3);
+    ASSERT_EQ(output[0], 0);
+    ASSERT_EQ(output[1], 2);
+    ASSERT_EQ(output[2], 3);
+
+    // the first element selected is proportional to the weight
+    constexpr uint64_t num_trials = 20000;
+    uint64_t count_heavy = 0;
+    for(uint64_t trial = 0; trial < num_trials; trial++){
+        num_samples = 1;
+        weighted_random_sample(input.data(), weights.data(), input.size(), output.data(), num_samples, trial);
+        ASSERT_EQ(num_samples, 1);
+        count_heavy += (output[0] == 3);
+    }
+    ASSERT_NEAR(count_heavy, num_trials * 0.8, 400);
+
+    // multiple chunks, the samples are distinct and sorted by position
+    vector<uint64_t> large_input(3 * details::sampling::chunk_sz);
+    iota(begin(large_input), end(large_input), 0);
+    vector<uint32_t> large_weights(large_input.size());
+    for(uint64_t i = 0; i < large_input.size(); i++){ large_weights[i] = 1 + (i % 7); }
+    num_samples = 100000;
+    vector<uint64_t> large_output(num_samples), large_output2(num_samples);
+    weighted_random_sample(large_input.data(), large_weights.data(), large_input.size(), large_output.data(), num_samples, /* seed */ 5);
+    ASSERT_EQ(num_samples, 100000);
+    validate(large_input, large_output, num_samples);
+    weighted_random_sample(large_input.data(), large_weights.data(), large_input.size(), large_output2.data(), num_samples, /* seed */ 5);
+    ASSERT_EQ(large_output, large_output2);
+}
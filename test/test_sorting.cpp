@@ -2,6 +2,12 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
 #include "lib/common/sorting.hpp"
 
 using namespace std;
@@ -56,3 +62,253 @@ TEST(Sorting, reverse){
 }
 
 
+TEST(Sorting, partition){
+    constexpr uint64_t array_sz = 100000;
+    constexpr uint64_t num_threads = 4;
+    vector<uint64_t> array(array_sz);
+    mt19937_64 random_generator{42};
+    for(uint64_t i = 0; i < array_sz; i++){ array[i] = random_generator() % 1000; }
+    vector<uint64_t> expected = array;
+    std::sort(expected.begin(), expected.end());
+
+    uint64_t splitters[] = { 100, 250, 250, 600 };
+    const uint64_t num_splitters = sizeof(splitters) / sizeof(splitters[0]);
+    uint64_t buckets[num_splitters +2];
+    unique_ptr<uint64_t[]> buffer { new uint64_t[array_sz] };
+    details::sorting::partition(array.data(), array_sz, std::less<uint64_t>(), splitters, num_splitters, buffer.get(), buckets, num_threads);
+
+    ASSERT_EQ(buckets[0], 0);
+    ASSERT_EQ(buckets[num_splitters +1], array_sz);
+    for(uint64_t b = 0; b <= num_splitters; b++){
+        ASSERT_LE(buckets[b], buckets[b +1]);
+        for(uint64_t i = buckets[b]; i < buckets[b +1]; i++){
+            if(b > 0) { ASSERT_GE(buffer[i], splitters[b -1]); }
+            if(b < num_splitters) { ASSERT_LT(buffer[i], splitters[b]); }
+        }
+    }
+    ASSERT_EQ(buckets[3], buckets[2]); // duplicate splitters, empty bucket
+
+    std::sort(buffer.get(), buffer.get() + array_sz);
+    for(uint64_t i = 0; i < array_sz; i++){ ASSERT_EQ(buffer[i], expected[i]); }
+}
+
+TEST(Sorting, random){
+    for(uint64_t array_sz : { 10ull, 1000ull, 200000ull }){
+        vector<string> array(array_sz);
+        mt19937_64 random_generator{array_sz};
+        for(uint64_t i = 0; i < array_sz; i++){ array[i] = to_string(random_generator() % (array_sz / 2 + 1)); }
+        vector<string> expected = array;
+        std::sort(expected.begin(), expected.end());
+
+        details::sorting::implementation(array.data(), array_sz, std::less<string>(), /* num samples */ 7);
+        ASSERT_EQ(array, expected);
+    }
+}
+
+TEST(Sorting, split_buckets){
+    constexpr uint64_t array_sz = 100000;
+    vector<int64_t> array(array_sz);
+    mt19937_64 random_generator{7};
+    for(uint64_t i = 0; i < array_sz; i++){ array[i] = random_generator() % 5000; }
+    vector<int64_t> expected = array;
+    std::sort(expected.begin(), expected.end());
+
+    ThreadPool pool { 4 };
+    TaskGroup group { pool };
+    details::sorting::sort_recursive(array.data(), array_sz, std::less<int64_t>(), group, /* max task size */ 1000);
+    group.wait();
+    ASSERT_EQ(array, expected);
+}
+
+TEST(Sorting, duplicates){
+    constexpr uint64_t array_sz = 100000;
+    vector<uint64_t> array(array_sz);
+    mt19937_64 random_generator{11};
+    for(uint64_t i = 0; i < array_sz; i++){ // 80% of the elements are equal to 42
+        array[i] = (random_generator() % 10 < 8) ? 42 : random_generator() % 1000;
+    }
+    vector<uint64_t> expected = array;
+    std::sort(expected.begin(), expected.end());
+
+    SortStatistics statistics;
+    details::sorting::implementation(array.data(), array_sz, std::less<uint64_t>(), /* num splitters */ 8, &statistics);
+    ASSERT_EQ(array, expected);
+
+    ASSERT_EQ(statistics.m_num_elements, array_sz);
+    ASSERT_EQ(statistics.m_num_samples, 8 * details::sorting::oversampling_factor);
+    ASSERT_TRUE(statistics.m_equality_buckets);
+    ASSERT_LT(statistics.m_num_splitters, 8);
+    ASSERT_EQ(statistics.m_num_buckets, 2 * statistics.m_num_splitters +1);
+    ASSERT_GE(statistics.m_num_equal_elements, array_sz * 3 / 4);
+    ASSERT_LT(statistics.m_largest_bucket, array_sz / 4);
+}
+
+TEST(Sorting, statistics){
+    constexpr uint64_t array_sz = 100000;
+    vector<uint64_t> array(array_sz);
+    for(uint64_t i = 0; i < array_sz; i++){ array[i] = array_sz - i; }
+
+    SortStatistics statistics;
+    details::sorting::implementation(array.data(), array_sz, std::less<uint64_t>(), /* num splitters */ 15, &statistics);
+    for(uint64_t i = 0; i < array_sz; i++){ ASSERT_EQ(array[i], i +1); }
+
+    ASSERT_FALSE(statistics.m_equality_buckets);
+    ASSERT_EQ(statistics.m_num_splitters, 15);
+    ASSERT_EQ(statistics.m_num_buckets, 16);
+    ASSERT_EQ(statistics.m_num_equal_elements, 0);
+    ASSERT_GE(statistics.m_imbalance, 1.0);
+    ASSERT_LT(statistics.m_imbalance, 3.0); // with oversampling, the buckets are close to even
+}
+
+template<typename T>
+static void check_radix(uint64_t array_sz, uint64_t max_value){
+    vector<T> array(array_sz);
+    mt19937_64 random_generator{array_sz};
+    for(uint64_t i = 0; i < array_sz; i++){
+        array[i] = static_cast<T>(random_generator() % max_value);
+        if(std::is_signed_v<T> && i % 3 == 0) array[i] = -array[i];
+    }
+    vector<T> expected = array;
+    std::sort(expected.begin(), expected.end());
+
+    details::sorting::radix::implementation(array.data(), array_sz);
+    ASSERT_EQ(array, expected);
+}
+
+TEST(Sorting, radix){
+    static_assert(details::sorting::radix::is_applicable<uint64_t, std::less<uint64_t>>);
+    static_assert(details::sorting::radix::is_applicable<int32_t, std::less<>>);
+    static_assert(!details::sorting::radix::is_applicable<uint64_t, std::greater<uint64_t>>);
+    static_assert(!details::sorting::radix::is_applicable<double, std::less<double>>);
+
+    for(uint64_t array_sz : { 0ull, 100ull, 100000ull }){
+        check_radix<uint32_t>(array_sz, numeric_limits<uint32_t>::max());
+        check_radix<uint64_t>(array_sz, numeric_limits<uint64_t>::max());
+        check_radix<uint64_t>(array_sz, 1000); // most passes are skipped
+        check_radix<int64_t>(array_sz, numeric_limits<int64_t>::max());
+        check_radix<int16_t>(array_sz, 30000);
+    }
+}
+
+TEST(Sorting, default_comparator){
+    vector<uint64_t> array { 50, 60, 30, 10, 40, 80, 90, 70, 20 };
+    common::sort(array.data(), array.size()); // radix sort
+    for(uint64_t i = 0; i < array.size(); i++){ ASSERT_EQ(array[i], (i +1) * 10); }
+
+    vector<double> array2 { 5.0, 6.0, 3.0, 1.0, 4.0, 8.0, 9.0, 7.0, 2.0 };
+    common::sort(array2.data(), array2.size()); // sample sort
+    for(uint64_t i = 0; i < array2.size(); i++){ ASSERT_EQ(array2[i], i +1); }
+}
+
+TEST(Sorting, argsort){
+    uint64_t keys[] = {50, 60, 30, 10, 40, 60, 90, 10, 20};
+    const uint64_t num_keys = sizeof(keys) / sizeof(keys[0]);
+
+    vector<uint64_t> permutation = common::argsort(keys, num_keys);
+    vector<uint64_t> expected { 3, 7, 8, 2, 4, 0, 1, 5, 6 }; // stable
+    ASSERT_EQ(permutation, expected);
+    ASSERT_EQ(keys[0], 50); // not altered
+
+    permutation = common::argsort(keys, num_keys, std::greater<uint64_t>());
+    expected = { 6, 1, 5, 0, 4, 2, 8, 3, 7 };
+    ASSERT_EQ(permutation, expected);
+
+    ASSERT_TRUE(common::argsort(keys, 0).empty());
+}
+
+TEST(Sorting, sort_by_key){
+    constexpr uint64_t num_edges = 100000;
+    vector<uint64_t> sources(num_edges), destinations(num_edges);
+    vector<double> weights(num_edges);
+    mt19937_64 random_generator{3};
+    for(uint64_t i = 0; i < num_edges; i++){
+        sources[i] = random_generator() % 1000;
+        destinations[i] = i;
+        weights[i] = sources[i] + static_cast<double>(i) / num_edges;
+    }
+
+    common::sort_by_key(sources.data(), num_edges, destinations.data(), weights.data());
+    for(uint64_t i = 0; i < num_edges; i++){
+        if(i > 0){
+            ASSERT_LE(sources[i -1], sources[i]);
+            if(sources[i -1] == sources[i]) { ASSERT_LT(destinations[i -1], destinations[i]); } // stable
+        }
+        ASSERT_EQ(weights[i], sources[i] + static_cast<double>(destinations[i]) / num_edges);
+    }
+
+    // custom comparator and non trivial payload
+    string names[] = { "c", "a", "b" };
+    int64_t ids[] = { 3, 1, 2 };
+    common::sort_by_key(std::greater<int64_t>(), ids, 3, names);
+    ASSERT_EQ(ids[0], 3);
+    ASSERT_EQ(names[0], "c");
+    ASSERT_EQ(names[2], "a");
+}
+
+TEST(Sorting, loser_tree){
+    vector<vector<int64_t>> runs { {1, 4, 7, 10}, {}, {2, 4, 8}, {0, 3, 4, 11, 12} };
+    vector<const int64_t*> starts, ends;
+    for(auto& run : runs){ starts.push_back(run.data()); ends.push_back(run.data() + run.size()); }
+
+    details::merge::LoserTree<int64_t, std::less<int64_t>> tree(starts.data(), ends.data(), runs.size(), std::less<int64_t>());
+    vector<const int64_t*> order; // stable, the fours are output in the order of the runs
+    vector<int64_t> result;
+    while(!tree.empty()){
+        result.push_back(tree.top());
+        if(tree.top() == 4) order.push_back(&tree.top());
+        tree.pop();
+    }
+    vector<int64_t> expected { 0, 1, 2, 3, 4, 4, 4, 7, 8, 10, 11, 12 };
+    ASSERT_EQ(result, expected);
+    ASSERT_EQ(order.size(), 3);
+    ASSERT_EQ(order[0], &runs[0][1]);
+    ASSERT_EQ(order[1], &runs[2][1]);
+    ASSERT_EQ(order[2], &runs[3][2]);
+}
+
+TEST(Sorting, merge){
+    for(uint64_t num_runs : {1, 2, 5, 17}){
+        for(uint64_t num_threads : {1, 3, 8}){
+            vector<vector<uint64_t>> runs(num_runs);
+            vector<const uint64_t*> run_ptrs;
+            vector<uint64_t> run_sizes, expected;
+            mt19937_64 random_generator{num_runs * 100 + num_threads};
+            for(auto& run : runs){
+                run.resize(random_generator() % 20000);
+                for(auto& e : run){ e = random_generator() % 5000; } // many duplicates
+                std::sort(run.begin(), run.end());
+                run_ptrs.push_back(run.data());
+                run_sizes.push_back(run.size());
+                expected.insert(expected.end(), run.begin(), run.end());
+            }
+            std::sort(expected.begin(), expected.end());
+
+            // the rank of each split must match the output range of the thread
+            for(uint64_t rank : {0ul, expected.size() / 3, expected.size() / 2, expected.size()}){
+                vector<uint64_t> splits(num_runs);
+                details::merge::select(run_ptrs.data(), run_sizes.data(), num_runs, rank, std::less<uint64_t>(), splits.data());
+                uint64_t total = 0;
+                for(uint64_t i = 0; i < num_runs; i++){
+                    total += splits[i];
+                    if(rank > 0 && rank < expected.size() && splits[i] > 0){ ASSERT_LE(runs[i][splits[i] -1], expected[rank]); }
+                    if(rank > 0 && splits[i] < run_sizes[i]){ ASSERT_GE(runs[i][splits[i]], expected[rank -1]); }
+                }
+                ASSERT_EQ(total, rank);
+            }
+
+            vector<uint64_t> output(expected.size());
+            details::merge::implementation(run_ptrs.data(), run_sizes.data(), num_runs, output.data(), std::less<uint64_t>(), num_threads);
+            ASSERT_EQ(output, expected);
+        }
+    }
+
+    // public api
+    vector<string> run1 { "a", "c", "e" }, run2 { "b", "d" };
+    const string* runs[] = { run1.data(), run2.data() };
+    uint64_t run_sizes[] = { 3, 2 };
+    vector<string> output(5);
+    common::merge(runs, run_sizes, 2, output.data());
+    vector<string> expected { "a", "b", "c", "d", "e" };
+    ASSERT_EQ(output, expected);
+}
+
@@ -1,11 +1,22 @@
 #include "gtest/gtest.h"
 
+#include "lib/common/concurrent_static_index.hpp"
+#include "lib/common/replicated_static_index.hpp"
 #include "lib/common/static_index.hpp"
+#include "lib/common/timer.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
 #include <unistd.h> // sleep
 #include <utility>
+#include <vector>
 
 using namespace std;
 using namespace common;
@@ -168,3 +179,598 @@ TEST(StaticIndex, duplicates){
     ASSERT_EQ(index.find_lte_last(25), 6);
     ASSERT_EQ(index.find_lte_last(26), 6);
 }
+
+// Compare the lookups of the index against a plain binary search on the separator keys
+template<typename KeyType, typename Layout = index_layout::BTree<>>
+static void check_against_sorted_keys(uint64_t node_size, uint64_t num_keys){
+    mt19937_64 random_generator{ num_keys };
+    vector<KeyType> keys;
+    KeyType key = 0;
+    for(uint64_t i = 0; i < num_keys; i++){
+        key += static_cast<KeyType>(1 + random_generator() % 8);
+        keys.push_back(key);
+    }
+
+    StaticIndex<KeyType, Layout> index(node_size, num_keys);
+    for(uint64_t i = 0; i < num_keys; i++){ index.set_separator_key(i, keys[i]); }
+
+    for(KeyType key = 0; key <= keys.back() +1; key += 1){
+        uint64_t lt = lower_bound(keys.begin() +1, keys.end(), key) - keys.begin() -1;
+        uint64_t lte = upper_bound(keys.begin() +1, keys.end(), key) - keys.begin() -1;
+        ASSERT_EQ(index.find_lt(key), lt) << "key: " << key;
+        ASSERT_EQ(index.find_lte(key), lte) << "key: " << key;
+        ASSERT_EQ(index.find_lte_first(key), lte) << "key: " << key;
+        ASSERT_EQ(index.find_lte_last(key), lte) << "key: " << key;
+    }
+}
+
+TEST(StaticIndex, simd){
+    using namespace common::details::static_index;
+    SimdLevel default_level = simd_level();
+
+    for(auto level : {SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512}){
+        if(set_simd_level(level) != level) continue; // not supported by this CPU
+
+        for(uint64_t node_size : {4, 17, 33, 65}){
+            check_against_sorted_keys<int32_t>(node_size, 2000);
+            check_against_sorted_keys<uint32_t>(node_size, 2000);
+            check_against_sorted_keys<int64_t>(node_size, 2000);
+            check_against_sorted_keys<uint64_t>(node_size, 2000);
+            check_against_sorted_keys<float>(node_size, 2000);
+            check_against_sorted_keys<double>(node_size, 2000);
+        }
+    }
+
+    set_simd_level(default_level);
+}
+
+TEST(StaticIndex, batch){
+    constexpr uint64_t num_entries = 5000;
+    mt19937_64 random_generator{ 42 };
+    StaticIndex<int64_t> index(/* node size */ 9, num_entries);
+    int64_t key = 0;
+    for(uint64_t i = 0; i < num_entries; i++){
+        key += random_generator() % 3; // with duplicates
+        index.set_separator_key(i, key);
+    }
+
+    constexpr uint64_t num_keys = 1003; // not a multiple of the batch size
+    vector<int64_t> keys(num_keys);
+    for(auto& k : keys){ k = static_cast<int64_t>(random_generator() % (key + 10)) -5; }
+    vector<uint64_t> out(num_keys);
+
+    index.find_lt(keys.data(), num_keys, out.data());
+    for(uint64_t i = 0; i < num_keys; i++){ ASSERT_EQ(out[i], index.find_lt(keys[i])); }
+    index.find_lte(keys.data(), num_keys, out.data());
+    for(uint64_t i = 0; i < num_keys; i++){ ASSERT_EQ(out[i], index.find_lte(keys[i])); }
+    index.find_lte_first(keys.data(), num_keys, out.data());
+    for(uint64_t i = 0; i < num_keys; i++){ ASSERT_EQ(out[i], index.find_lte_first(keys[i])); }
+    index.find_lte_last(keys.data(), num_keys, out.data());
+    for(uint64_t i = 0; i < num_keys; i++){ ASSERT_EQ(out[i], index.find_lte_last(keys[i])); }
+}
+
+TEST(StaticIndex, build){
+    for(uint64_t node_size : {4, 5, 65}){
+        for(uint64_t num_entries : {1, 2, 3, 7, 64, 65, 66, 366, 4000, 4224, 4225, 4226, 40000}){
+            vector<int64_t> separators(num_entries);
+            for(uint64_t i = 0; i < num_entries; i++){ separators[i] = (i+1) * 10; }
+
+            StaticIndex<int64_t> expected(node_size, num_entries);
+            for(uint64_t i = 0; i < num_entries; i++){ expected.set_separator_key(i, separators[i]); }
+
+            for(uint64_t num_threads : {1, 4}){
+                StaticIndex<int64_t> index(node_size); // rebuilt by #build
+                index.build(separators.data(), num_entries, num_threads);
+                ASSERT_EQ(index.height(), expected.height());
+                for(uint64_t i = 0; i < num_entries; i++){
+                    ASSERT_EQ(index.get_separator_key(i), separators[i]) << "node size: " << node_size << ", entries: " << num_entries << ", i: " << i;
+                }
+                for(uint64_t i = 0; i < num_entries; i++){
+                    ASSERT_EQ(index.find_lte(separators[i]), i);
+                    ASSERT_EQ(index.find_lt(separators[i]), expected.find_lt(separators[i]));
+                }
+            }
+        }
+    }
+}
+
+template<typename Layout>
+static void check_layout(){
+    // lookups
+    for(uint64_t node_size : {2, 3, 5, 9, 17}){
+        for(uint64_t num_keys : {1, 2, 3, 16, 17, 100, 2000}){
+            check_against_sorted_keys<int64_t, Layout>(node_size, num_keys);
+            check_against_sorted_keys<double, Layout>(node_size, num_keys);
+        }
+    }
+
+    { // duplicates, same expectations of the test `duplicates'
+        StaticIndex<int, Layout> index(/* node size */ 4, /* number of keys */ 7);
+        int separators[] = {5, 5, 10, 10, 15, 20, 25};
+        for(int i = 0; i < 7; i++){ index.set_separator_key(i, separators[i]); }
+        ASSERT_EQ(index.find_lt(4), 0);
+        ASSERT_EQ(index.find_lt(5), 0);
+        ASSERT_EQ(index.find_lt(9), 1);
+        ASSERT_EQ(index.find_lt(10), 1);
+        ASSERT_EQ(index.find_lt(11), 3);
+        ASSERT_EQ(index.find_lte_first(5), 0);
+        ASSERT_EQ(index.find_lte_first(6), 1);
+        ASSERT_EQ(index.find_lte_first(10), 2);
+        ASSERT_EQ(index.find_lte_first(11), 3);
+        ASSERT_EQ(index.find_lte_first(25), 6);
+        ASSERT_EQ(index.find_lte_first(26), 6);
+        ASSERT_EQ(index.find_lte_last(4), 0);
+        ASSERT_EQ(index.find_lte_last(5), 1);
+        ASSERT_EQ(index.find_lte_last(10), 3);
+        ASSERT_EQ(index.find_lte_last(15), 4);
+        ASSERT_EQ(index.find_lte_last(26), 6);
+        bool integrity_check = true;
+        stringstream ss;
+        index.dump(ss, &integrity_check);
+        ASSERT_TRUE(integrity_check);
+    }
+
+    // build & batched lookups, against the B-Tree layout
+    constexpr uint64_t num_entries = 3000;
+    mt19937_64 random_generator{ 7 };
+    vector<int64_t> separators(num_entries);
+    int64_t key = 0;
+    for(auto& s : separators){ key += random_generator() % 3; s = key; }
+    StaticIndex<int64_t> expected(/* node size */ 5);
+    expected.build(separators.data(), num_entries);
+    for(uint64_t num_threads : {1, 3}){
+        StaticIndex<int64_t, Layout> index(/* node size */ 5);
+        index.build(separators.data(), num_entries, num_threads);
+        for(uint64_t i = 0; i < num_entries; i++){ ASSERT_EQ(index.get_separator_key(i), separators[i]); }
+
+        vector<int64_t> keys(1000);
+        for(auto& k : keys){ k = static_cast<int64_t>(random_generator() % (key + 10)) -5; }
+        vector<uint64_t> out(keys.size());
+        index.find_lt(keys.data(), keys.size(), out.data());
+        for(uint64_t i = 0; i < keys.size(); i++){ ASSERT_EQ(out[i], expected.find_lt(keys[i])); }
+        index.find_lte(keys.data(), keys.size(), out.data());
+        for(uint64_t i = 0; i < keys.size(); i++){ ASSERT_EQ(out[i], expected.find_lte(keys[i])); }
+        index.find_lte_last(keys.data(), keys.size(), out.data());
+        for(uint64_t i = 0; i < keys.size(); i++){ ASSERT_EQ(out[i], expected.find_lte_last(keys[i])); }
+        index.find_lte_first(keys.data(), keys.size(), out.data());
+        for(uint64_t i = 0; i < keys.size(); i++){ ASSERT_EQ(out[i], expected.find_lte_first(keys[i])); }
+    }
+
+    // repeated keys, the results of #find_lte_first depend on the shape of the B-Tree layout
+    for(uint64_t node_size : {3, 5, 9}){
+        for(uint64_t num_entries : {2, 3, 10, 26, 27, 28, 100, 244, 1000, 3000}){
+            vector<int64_t> repeated(num_entries);
+            int64_t last = 0;
+            for(auto& s : repeated){ last += (random_generator() % 4 == 0); s = last; }
+            StaticIndex<int64_t> expected(node_size);
+            expected.build(repeated.data(), num_entries);
+            StaticIndex<int64_t, Layout> index(node_size);
+            index.build(repeated.data(), num_entries);
+
+            vector<int64_t> keys;
+            for(int64_t k = -1; k <= last + 1; k++){ keys.push_back(k); }
+            vector<uint64_t> out(keys.size());
+            index.find_lte_first(keys.data(), keys.size(), out.data());
+            for(uint64_t i = 0; i < keys.size(); i++){
+                ASSERT_EQ(index.find_lt(keys[i]), expected.find_lt(keys[i])) << "node size: " << node_size << ", entries: " << num_entries << ", key: " << keys[i];
+                ASSERT_EQ(index.find_lte_first(keys[i]), expected.find_lte_first(keys[i])) << "node size: " << node_size << ", entries: " << num_entries << ", key: " << keys[i];
+                ASSERT_EQ(out[i], expected.find_lte_first(keys[i])) << "node size: " << node_size << ", entries: " << num_entries << ", key: " << keys[i];
+                ASSERT_EQ(index.find_lte_last(keys[i]), expected.find_lte_last(keys[i])) << "node size: " << node_size << ", entries: " << num_entries << ", key: " << keys[i];
+                ASSERT_EQ(index.scan(keys[i], keys[i]).position(), expected.scan(keys[i], keys[i]).position());
+            }
+        }
+    }
+}
+
+TEST(StaticIndex, layout_eytzinger){
+    check_layout<index_layout::Eytzinger>();
+}
+
+TEST(StaticIndex, layout_van_emde_boas){
+    check_layout<index_layout::VanEmdeBoas>();
+}
+
+TEST(StaticIndex, fixed_node_size){
+    for(uint64_t num_keys : {1, 2, 3, 16, 17, 64, 65, 66, 2000, 4225, 4226}){
+        check_against_sorted_keys<int64_t, index_layout::BTree<5>>(5, num_keys);
+        check_against_sorted_keys<int64_t, index_layout::BTree<65>>(65, num_keys);
+        check_against_sorted_keys<double, index_layout::BTree<17>>(17, num_keys);
+    }
+
+    StaticIndex<int64_t, index_layout::BTree<17>> index; // default node size given by the layout
+    ASSERT_EQ(index.node_size(), 17);
+    ASSERT_THROW((StaticIndex<int64_t, index_layout::BTree<17>>{ /* node size */ 16 }), std::invalid_argument);
+    ASSERT_THROW((StaticIndex<int64_t>{ /* node size */ 1 }), std::invalid_argument);
+}
+
+// The height of the tree used to be computed with floating point arithmetic, this combination was rounded up to a wrong height
+TEST(StaticIndex, height_rounding){
+    check_against_sorted_keys<int64_t>(/* node size */ 5, /* number of keys */ 50000);
+    check_against_sorted_keys<int64_t, index_layout::BTree<5>>(/* node size */ 5, /* number of keys */ 50000);
+    check_against_sorted_keys<int64_t>(/* node size */ 5, /* number of keys */ 3125);
+    check_against_sorted_keys<int64_t>(/* node size */ 5, /* number of keys */ 3126);
+}
+
+// Readers query the index while a writer keeps publishing new versions, with different sizes
+TEST(StaticIndex, concurrent){
+    constexpr uint64_t num_readers = 4;
+    constexpr uint64_t num_versions = 200;
+    constexpr uint64_t min_entries = 1000;
+    ConcurrentStaticIndex<int64_t> index(/* node size */ 9);
+    atomic<bool> done = false;
+    atomic<uint64_t> num_errors = 0;
+
+    auto make_version = [](uint64_t version){ // separators: i * 4 + (version % 4)
+        vector<int64_t> separators(min_entries + (version % 17) * 37);
+        for(uint64_t i = 0; i < separators.size(); i++){ separators[i] = i * 4 + (version % 4); }
+        return separators;
+    };
+    auto separators = make_version(0);
+    index.build(separators.data(), separators.size());
+
+    vector<thread> readers;
+    for(uint64_t reader_id = 0; reader_id < num_readers; reader_id++){
+        readers.emplace_back([&, reader_id](){
+            mt19937_64 random_generator{ reader_id };
+            vector<int64_t> keys(64);
+            vector<uint64_t> out(keys.size());
+            do {
+                // regardless of the version, the key i * 4 + 3 is always mapped to i
+                uint64_t i = random_generator() % min_entries;
+                if(index.find_lte(i * 4 + 3) != i){ num_errors++; }
+                if(index.minimum() > 3){ num_errors++; }
+                for(uint64_t j = 0; j < keys.size(); j++){ keys[j] = ((i + j) % min_entries) * 4 + 3; }
+                index.find_lte(keys.data(), keys.size(), out.data());
+                for(uint64_t j = 0; j < keys.size(); j++){ if(out[j] != (i + j) % min_entries) num_errors++; }
+            } while(!done);
+        });
+    }
+
+    for(uint64_t version = 1; version <= num_versions; version++){
+        separators = make_version(version);
+        if(version % 2 == 0){
+            index.build(separators.data(), separators.size(), /* num threads */ 2);
+        } else {
+            unique_ptr<StaticIndex<int64_t>> snapshot { new StaticIndex<int64_t>(/* node size */ 9, separators.size()) };
+            for(uint64_t i = 0; i < separators.size(); i++){ snapshot->set_separator_key(i, separators[i]); }
+            index.publish(move(snapshot));
+        }
+        this_thread::yield();
+    }
+    done = true;
+    for(auto& t : readers){ t.join(); }
+
+    ASSERT_EQ(num_errors, 0);
+    ASSERT_EQ(index.reclaim(), 0); // no readers left, all previous versions can be released
+    ASSERT_EQ(index.find_lte(separators.back()), separators.size() -1);
+    ASSERT_EQ(index.read([](const StaticIndex<int64_t>& snapshot){ return snapshot.minimum(); }), num_versions % 4);
+}
+
+// The lookups do not depend on how the keys are allocated
+TEST(StaticIndex, allocation_policy){
+    constexpr uint64_t num_entries = 100000;
+    vector<int64_t> separators(num_entries);
+    for(uint64_t i = 0; i < num_entries; i++){ separators[i] = i * 2; }
+
+    for(auto page_size : {memory::PageSize::DEFAULT, memory::PageSize::TRANSPARENT, memory::PageSize::HUGE_2MB}){
+        for(auto numa_policy : {memory::NumaPolicy::DEFAULT, memory::NumaPolicy::INTERLEAVE, memory::NumaPolicy::BIND}){
+            memory::AllocationPolicy policy;
+            policy.m_page_size = page_size;
+            policy.m_numa_policy = numa_policy;
+            policy.m_numa_node = 0;
+
+            StaticIndex<int64_t> index(/* node size */ 65, /* num entries */ 1, policy);
+            StaticIndex<int64_t, index_layout::Eytzinger> eytzinger(/* node size */ 17, /* num entries */ 1, policy);
+            for(uint64_t num_keys : {num_entries /10, num_entries, 7ul}){ // reallocate the keys
+                index.build(separators.data(), num_keys);
+                eytzinger.build(separators.data(), num_keys);
+                for(uint64_t i = 0; i < num_keys; i++){
+                    ASSERT_EQ(index.find_lte(i * 2 + 1), i) << "policy: " << policy;
+                    ASSERT_EQ(eytzinger.find_lte(i * 2 + 1), i) << "policy: " << policy;
+                }
+            }
+        }
+    }
+}
+
+TEST(StaticIndex, replicated){
+    constexpr uint64_t num_entries = 10000;
+    vector<int64_t> separators(num_entries);
+    for(uint64_t i = 0; i < num_entries; i++){ separators[i] = i * 3; }
+
+    ReplicatedStaticIndex<int64_t> index(/* node size */ 33);
+    ASSERT_GE(index.num_replicas(), 1);
+    index.build(separators.data(), num_entries, /* num threads */ 2);
+    ASSERT_EQ(index.capacity(), num_entries);
+    index.set_separator_key(num_entries -1, separators.back() +1);
+    for(uint64_t i = 0; i < num_entries -1; i++){ ASSERT_EQ(index.find_lte(i * 3 + 2), i); }
+    ASSERT_EQ(index.find_lte(separators.back()), num_entries -2);
+    for(uint64_t node = 0; node < index.num_replicas(); node++){
+        ASSERT_EQ(index.replica(node).find_lte(separators.back() +1), num_entries -1);
+    }
+    ASSERT_EQ(index.memory_footprint(), index.replica(0).memory_footprint() * index.num_replicas());
+
+    index.append(separators.back() +2);
+    ASSERT_EQ(index.capacity(), num_entries +1);
+    for(uint64_t node = 0; node < index.num_replicas(); node++){
+        ASSERT_EQ(index.replica(node).capacity(), num_entries +1);
+        ASSERT_EQ(index.replica(node).find_lte(separators.back() +2), num_entries);
+    }
+}
+
+template<typename Layout>
+static void check_scan(uint64_t node_size, uint64_t num_entries){
+    mt19937_64 random_generator{ num_entries };
+    vector<int64_t> separators(num_entries);
+    int64_t key = 0;
+    for(auto& s : separators){ key += random_generator() % 3; s = key; } // with duplicates
+    StaticIndex<int64_t, Layout> index(node_size);
+    index.build(separators.data(), num_entries);
+
+    // full scan
+    uint64_t expected_position = 0;
+    for(auto it = index.scan(); it.valid(); it.next()){
+        ASSERT_EQ(it.position(), expected_position);
+        ASSERT_EQ(it.key(), separators[expected_position]);
+        expected_position++;
+    }
+    ASSERT_EQ(expected_position, num_entries);
+
+    // range scans
+    for(uint64_t i = 0; i < 200; i++){
+        int64_t lo = static_cast<int64_t>(random_generator() % (key + 4)) -2;
+        int64_t hi = lo + static_cast<int64_t>(random_generator() % 20);
+        uint64_t first = index.find_lte_first(lo);
+        uint64_t last = index.find_lte_last(hi);
+        uint64_t position = first;
+        for(auto it = index.scan(lo, hi); it.valid(); it.next()){
+            ASSERT_EQ(it.position(), position) << "lo: " << lo << ", hi: " << hi;
+            ASSERT_EQ(it.key(), separators[position]);
+            position++;
+        }
+        ASSERT_EQ(position, last +1) << "lo: " << lo << ", hi: " << hi;
+    }
+}
+
+TEST(StaticIndex, scan){
+    for(uint64_t num_entries : {1, 2, 3, 4, 5, 17, 64, 65, 66, 1000, 4225, 4226}){
+        check_scan<index_layout::BTree<>>(/* node size */ 4, num_entries);
+        check_scan<index_layout::BTree<>>(/* node size */ 65, num_entries);
+        check_scan<index_layout::BTree<5>>(/* node size */ 5, num_entries);
+        check_scan<index_layout::Eytzinger>(/* node size */ 9, num_entries);
+        check_scan<index_layout::VanEmdeBoas>(/* node size */ 2, num_entries);
+    }
+}
+
+TEST(StaticIndex, save_and_open){
+    const string path = "/tmp/libcommon_test_static_index_" + to_string(getpid()) + ".idx";
+
+    for(uint64_t num_entries : {1, 2, 66, 4226, 100000}){
+        vector<int64_t> separators(num_entries);
+        for(uint64_t i = 0; i < num_entries; i++){ separators[i] = i * 3 + 10; }
+        StaticIndex<int64_t> expected(/* node size */ 17);
+        expected.build(separators.data(), num_entries);
+        expected.save(path);
+
+        auto index = StaticIndex<int64_t>::open(path);
+        ASSERT_TRUE(index->is_read_only());
+        ASSERT_FALSE(expected.is_read_only());
+        ASSERT_EQ(index->node_size(), 17);
+        ASSERT_EQ(index->height(), expected.height());
+        ASSERT_EQ(index->minimum(), 10);
+        for(uint64_t i = 0; i < num_entries; i++){
+            ASSERT_EQ(index->get_separator_key(i), separators[i]);
+            ASSERT_EQ(index->find_lte(separators[i] +1), i);
+            ASSERT_EQ(index->find_lt(separators[i]), expected.find_lt(separators[i]));
+        }
+        bool integrity_check = true;
+        stringstream ss;
+        index->dump(ss, &integrity_check);
+        ASSERT_TRUE(integrity_check);
+
+        ASSERT_THROW(index->set_separator_key(0, 1), std::logic_error);
+        ASSERT_THROW(index->rebuild(10), std::logic_error);
+    }
+
+    // the layout and the key type must match the ones of the file
+    ASSERT_THROW(StaticIndex<int32_t>::open(path), std::invalid_argument);
+    ASSERT_THROW(StaticIndex<double>::open(path), std::invalid_argument);
+    ASSERT_THROW((StaticIndex<int64_t, index_layout::BTree<65>>::open(path)), std::invalid_argument);
+    ASSERT_NO_THROW((StaticIndex<int64_t, index_layout::BTree<17>>::open(path)));
+
+    { // capacity too big for the 32 bits of StaticIndex::m_capacity, with a consistent shape and a sparse array of keys
+        const int64_t node_size = 17, capacity = (int64_t(1) << 31) + 66;
+        int64_t height = 0, power = 1;
+        while(power < capacity){ power *= node_size; height++; }
+        uint16_t rightmost[16] = {0}; // FileHeader::m_rightmost, pairs (root size, height of the rightmost subtree)
+        int64_t N = capacity;
+        for(int64_t h = height; h > 0; ){
+            int64_t subtree_sz = 1;
+            for(int64_t i = 1; i < h; i++) subtree_sz *= node_size;
+            rightmost[(h -1) * 2] = (N -1) / subtree_sz;
+            int64_t rightmost_sz = (N -1) % subtree_sz, rightmost_height = 0;
+            if(rightmost_sz > 0){
+                rightmost_sz++;
+                for(int64_t p = 1; p < rightmost_sz; p *= node_size) rightmost_height++;
+            }
+            rightmost[(h -1) * 2 +1] = rightmost_height;
+            N = rightmost_sz; h = rightmost_height;
+        }
+        uint64_t keys_sz = (power -1) * sizeof(int64_t);
+
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(32); // FileHeader::m_height, m_capacity, m_rightmost
+        file.write(reinterpret_cast<const char*>(&height), sizeof(height));
+        file.write(reinterpret_cast<const char*>(&capacity), sizeof(capacity));
+        file.write(reinterpret_cast<const char*>(rightmost), sizeof(rightmost));
+        file.seekp(96); // FileHeader::m_keys_sz
+        file.write(reinterpret_cast<const char*>(&keys_sz), sizeof(keys_sz));
+        file.close();
+        ASSERT_EQ(truncate(path.c_str(), 4096 + keys_sz), 0);
+        ASSERT_THROW(StaticIndex<int64_t>::open(path), std::invalid_argument);
+    }
+
+    // truncated file
+    ASSERT_EQ(truncate(path.c_str(), 4096 + 100), 0);
+    ASSERT_THROW(StaticIndex<int64_t>::open(path), std::invalid_argument);
+
+    unlink(path.c_str());
+    ASSERT_THROW(StaticIndex<int64_t>::open(path), std::runtime_error);
+
+    // the errors while saving report their cause
+    StaticIndex<int64_t> index(/* node size */ 17, /* num entries */ 1000);
+    ASSERT_THROW(index.save(path + ".missing_dir/index"), std::runtime_error);
+    if(access("/dev/full", W_OK) == 0){ // every write fails with ENOSPC
+        try {
+            index.save("/dev/full");
+            FAIL() << "Expected an exception";
+        } catch(std::runtime_error& e){
+            ASSERT_NE(string(e.what()).find(strerror(ENOSPC)), string::npos) << e.what();
+        }
+    }
+}
+
+template<typename Layout>
+static void check_append(uint64_t node_size, uint64_t num_entries){
+    mt19937_64 random_generator{ node_size };
+    vector<int64_t> separators;
+    StaticIndex<int64_t, Layout> index(node_size);
+    separators.push_back(index.minimum()); // the entry 0 is always present
+    int64_t key = 0;
+    index.set_separator_key(0, key);
+    separators[0] = key;
+
+    while(separators.size() < num_entries){
+        key += random_generator() % 3;
+        index.append(key);
+        separators.push_back(key);
+        ASSERT_EQ(index.capacity(), separators.size());
+
+        // check the whole content every now and then
+        if(separators.size() % 97 == 0 || separators.size() < 100 || separators.size() == num_entries){
+            uint64_t position = 0;
+            for(auto it = index.scan(); it.valid(); it.next()){
+                ASSERT_EQ(it.key(), separators[position]) << "position: " << position << ", capacity: " << separators.size();
+                position++;
+            }
+            ASSERT_EQ(position, separators.size());
+            for(uint64_t i = 0; i < separators.size(); i++){
+                ASSERT_EQ(index.find_lte_last(separators[i]), upper_bound(separators.begin(), separators.end(), separators[i]) - separators.begin() -1);
+            }
+        }
+    }
+
+    ASSERT_THROW(index.append(key -1), std::invalid_argument);
+}
+
+TEST(StaticIndex, append){
+    check_append<index_layout::BTree<>>(/* node size */ 2, 256); // the maximum height is 8
+    check_append<index_layout::BTree<>>(/* node size */ 3, 2000);
+    check_append<index_layout::BTree<>>(/* node size */ 5, 4000);
+    check_append<index_layout::BTree<>>(/* node size */ 65, 5000);
+    check_append<index_layout::BTree<9>>(/* node size */ 9, 2000);
+    check_append<index_layout::Eytzinger>(/* node size */ 5, 2000);
+    check_append<index_layout::VanEmdeBoas>(/* node size */ 2, 2000);
+}
+
+// Throughput of the lookups #find_lte, one key at the time and batched, over `num_entries' random separators
+template<typename Layout>
+static void benchmark_lookups(const char* name, uint64_t node_size, uint64_t num_entries, uint64_t num_lookups){
+    mt19937_64 random_generator{ 42 };
+    vector<int64_t> separators(num_entries);
+    for(auto& s : separators){ s = static_cast<int64_t>(random_generator() >> 1); }
+    sort(begin(separators), end(separators));
+    StaticIndex<int64_t, Layout> index(node_size);
+    index.build(separators.data(), num_entries);
+
+    vector<int64_t> keys(num_lookups);
+    for(auto& k : keys){ k = static_cast<int64_t>(random_generator() >> 1); }
+    vector<uint64_t> out(num_lookups);
+
+    Timer<true> timer_single;
+    timer_single.start();
+    for(uint64_t i = 0; i < num_lookups; i++){ out[i] = index.find_lte(keys[i]); }
+    timer_single.stop();
+    uint64_t checksum = accumulate(begin(out), end(out), uint64_t(0));
+
+    Timer<true> timer_batched;
+    timer_batched.start();
+    index.find_lte(keys.data(), num_lookups, out.data());
+    timer_batched.stop();
+    ASSERT_EQ(accumulate(begin(out), end(out), uint64_t(0)), checksum);
+
+    auto mops = [num_lookups](const Timer<true>& timer){ return static_cast<double>(num_lookups) / timer.microseconds(); };
+    cout << "[" << name << ", node size: " << node_size << ", entries: " << num_entries << "] single: " << mops(timer_single) <<
+            " Mops, batched: " << mops(timer_batched) << " Mops" << endl;
+}
+
+// Not executed by default, run with --gtest_also_run_disabled_tests --gtest_filter='StaticIndex.DISABLED_benchmark*'
+TEST(StaticIndex, DISABLED_benchmark_batched){
+    for(uint64_t num_entries : {100000, 10000000}){
+        benchmark_lookups<index_layout::BTree<>>("BTree", /* node size */ 65, num_entries, /* lookups */ 4000000);
+    }
+}
+
+// Compare the layouts, see index_layout
+TEST(StaticIndex, DISABLED_benchmark_layouts){
+    constexpr uint64_t num_entries = 10000000, num_lookups = 4000000;
+    benchmark_lookups<index_layout::BTree<>>("BTree", /* node size */ 65, num_entries, num_lookups);
+    benchmark_lookups<index_layout::BTree<>>("BTree", /* node size */ 17, num_entries, num_lookups);
+    benchmark_lookups<index_layout::Eytzinger>("Eytzinger", /* node size */ 17, num_entries, num_lookups);
+    benchmark_lookups<index_layout::Eytzinger>("Eytzinger", /* node size */ 9, num_entries, num_lookups);
+    benchmark_lookups<index_layout::VanEmdeBoas>("van Emde Boas", /* node size */ 2, num_entries, num_lookups);
+}
+
+// Throughput of the single lookups #find_lte with the scalar node search and with the instruction set detected
+template<typename KeyType>
+static void benchmark_simd(uint64_t num_entries, uint64_t num_lookups){
+    using namespace common::details::static_index;
+
+    // the separators and the index, whose tree is allocated with B^height -1 keys. Skip the sizes that do not fit in memory
+    const uint64_t node_size = 65;
+    uint64_t tree_sz = 1;
+    while(tree_sz < num_entries){ tree_sz *= node_size; }
+    const uint64_t memory_required = (num_entries + tree_sz) * sizeof(KeyType);
+    const uint64_t memory_available = static_cast<uint64_t>(sysconf(_SC_AVPHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+    if(memory_required > memory_available / 10 * 8){
+        cout << "[" << (is_same_v<KeyType, double> ? "double" : "int64_t") << ", " << num_entries << " entries] skipped, it requires " << memory_required / (1ull << 20) << " MB" << endl;
+        return;
+    }
+
+    vector<KeyType> separators(num_entries);
+    for(uint64_t i = 0; i < num_entries; i++){ separators[i] = static_cast<KeyType>(i * 3); }
+    StaticIndex<KeyType> index(node_size);
+    index.build(separators.data(), num_entries);
+    vector<KeyType>().swap(separators); // release the memory
+
+    mt19937_64 random_generator{ 42 };
+    vector<KeyType> keys(num_lookups);
+    for(auto& k : keys){ k = static_cast<KeyType>(random_generator() % (num_entries * 3)); }
+
+    const SimdLevel default_level = simd_level();
+    auto run = [&](SimdLevel level, uint64_t& checksum){
+        set_simd_level(level);
+        Timer<true> timer;
+        timer.start();
+        checksum = 0;
+        for(uint64_t i = 0; i < num_lookups; i++){ checksum += index.find_lte(keys[i]); }
+        timer.stop();
+        return static_cast<double>(num_lookups) / timer.microseconds();
+    };
+    uint64_t checksum_scalar = 0, checksum_simd = 0;
+    double mops_scalar = run(SimdLevel::SCALAR, checksum_scalar);
+    double mops_simd = run(default_level, checksum_simd);
+    set_simd_level(default_level);
+    ASSERT_EQ(checksum_scalar, checksum_simd);
+
+    cout << "[" << (is_same_v<KeyType, double> ? "double" : "int64_t") << ", " << num_entries << " entries] scalar: " << mops_scalar <<
+            " Mops, SIMD level " << static_cast<int>(default_level) << ": " << mops_simd << " Mops" << endl;
+}
+
+// Not executed by default, run with --gtest_also_run_disabled_tests --gtest_filter='StaticIndex.DISABLED_benchmark_simd'
+TEST(StaticIndex, DISABLED_benchmark_simd){
+    for(uint64_t num_entries : {1000000ull, 10000000ull, 100000000ull, 1000000000ull}){
+        benchmark_simd<int64_t>(num_entries, /* lookups */ 2000000);
+        benchmark_simd<double>(num_entries, /* lookups */ 2000000);
+    }
+}
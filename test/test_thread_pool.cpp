@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <stdexcept>
+#include "lib/common/thread_pool.hpp"
+
+using namespace std;
+using namespace common;
+
+TEST(ThreadPool, sanity){
+    ThreadPool pool { 4 };
+    ASSERT_EQ(pool.num_threads(), 4);
+    atomic<uint64_t> sum = 0;
+    TaskGroup group { pool };
+    for(uint64_t i = 1; i <= 1000; i++){
+        group.run([&sum, i](){ sum += i; });
+    }
+    group.wait();
+    ASSERT_EQ(sum, 500500);
+}
+
+// Tasks spawning and waiting for other tasks
+static uint64_t fibonacci(TaskGroup& parent, uint64_t n){
+    if(n < 2) return n;
+    uint64_t f1 = 0;
+    TaskGroup group { parent.pool() };
+    group.run([&](){ f1 = fibonacci(group, n -1); });
+    uint64_t f2 = fibonacci(group, n -2);
+    group.wait();
+    return f1 + f2;
+}
+
+TEST(ThreadPool, nested){
+    ThreadPool pool { 3 };
+    TaskGroup group { pool };
+    ASSERT_EQ(fibonacci(group, 20), 6765);
+}
+
+TEST(ThreadPool, no_workers){
+    ThreadPool pool { 0 }; // the tasks are executed by the thread waiting
+    TaskGroup group { pool };
+    uint64_t count = 0;
+    for(uint64_t i = 0; i < 10; i++){ group.run([&count](){ count++; }); }
+    ASSERT_EQ(count, 0);
+    group.wait();
+    ASSERT_EQ(count, 10);
+}
+
+TEST(ThreadPool, exception){
+    ThreadPool pool { 2 };
+    TaskGroup group { pool };
+    atomic<uint64_t> count = 0;
+    for(uint64_t i = 0; i < 100; i++){
+        group.run([&count, i](){
+            count++;
+            if(i == 50) throw std::runtime_error("error");
+        });
+    }
+    ASSERT_THROW(group.wait(), std::runtime_error);
+    ASSERT_EQ(count, 100); // the other tasks are still executed
+    group.wait(); // the exception is only raised once
+}